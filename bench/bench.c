@@ -0,0 +1,316 @@
+// Copyright (c) 2021 Caden Ji
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Measures the decoding throughput of the test images. Each image is scaled up
+// by repeating its pixel data vertically, so that the decoding time is not
+// dominated by the per call overhead.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tgafunc.h"
+
+// The number of times the pixel data of the source image is repeated.
+#define SCALE_FACTOR 64
+// The number of times each image is decoded.
+#define ITERATION_COUNT 20
+
+struct scaled_image {
+    uint8_t *buffer;
+    size_t size;
+};
+
+static uint8_t *read_file(const char *file_name, size_t *size_out) {
+    FILE *file = fopen(file_name, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    size_t size = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *buffer = (uint8_t *)malloc(size);
+    if (buffer != NULL && fread(buffer, 1, size, file) != size) {
+        free(buffer);
+        buffer = NULL;
+    }
+    fclose(file);
+    *size_out = size;
+    return buffer;
+}
+
+// Returns the byte size of the RLE pixel data starting at `data`.
+static size_t get_rle_data_size(const uint8_t *data, size_t pixel_count,
+                                int pixel_size) {
+    const uint8_t *p = data;
+    while (pixel_count > 0) {
+        size_t count = (*p & 0x7F) + 1;
+        size_t packet_size =
+            (*p & 0x80) ? (size_t)pixel_size : count * pixel_size;
+        p += 1 + packet_size;
+        pixel_count -= count < pixel_count ? count : pixel_count;
+    }
+    return (size_t)(p - data);
+}
+
+// Creates a TGA image which is SCALE_FACTOR times as high as the source image.
+static int create_scaled_image(struct scaled_image *image,
+                               const char *file_name) {
+    size_t file_size;
+    uint8_t *file_data = read_file(file_name, &file_size);
+    if (file_data == NULL) {
+        return 1;
+    }
+    uint8_t *header = file_data;
+    int map_size = header[1] ? (header[5] | header[6] << 8) *
+                                   ((header[7] + 7) / 8)
+                             : 0;
+    int width = header[12] | header[13] << 8;
+    int height = header[14] | header[15] << 8;
+    int pixel_size = (header[16] + 7) / 8;
+    size_t pixel_offset = 18 + header[0] + map_size;
+    size_t pixel_count = (size_t)width * height;
+    size_t data_size;
+    if (header[2] & 0x08) {
+        data_size = get_rle_data_size(file_data + pixel_offset, pixel_count,
+                                      pixel_size);
+    } else {
+        data_size = pixel_count * pixel_size;
+    }
+
+    image->size = pixel_offset + data_size * SCALE_FACTOR;
+    image->buffer = (uint8_t *)malloc(image->size);
+    if (image->buffer == NULL) {
+        free(file_data);
+        return 1;
+    }
+    memcpy(image->buffer, file_data, pixel_offset);
+    for (int i = 0; i < SCALE_FACTOR; i++) {
+        memcpy(image->buffer + pixel_offset + data_size * i,
+               file_data + pixel_offset, data_size);
+    }
+    int scaled_height = height * SCALE_FACTOR;
+    image->buffer[14] = scaled_height & 0xFF;
+    image->buffer[15] = (scaled_height >> 8) & 0xFF;
+    free(file_data);
+    return 0;
+}
+
+static int write_file(const char *file_name, const uint8_t *data,
+                      size_t size) {
+    FILE *file = fopen(file_name, "wb");
+    if (file == NULL) {
+        return 1;
+    }
+    size_t written = fwrite(data, 1, size, file);
+    fclose(file);
+    return written != size;
+}
+
+// Returns the decoding throughput in MB/s, or a negative value on failure.
+static double bench_load(const char *file_name, const uint8_t *buffer,
+                         size_t size) {
+    size_t decoded_size = 0;
+    clock_t start = clock();
+    for (int i = 0; i < ITERATION_COUNT; i++) {
+        uint8_t *data;
+        tga_info *info;
+        enum tga_error error_code;
+        if (file_name != NULL) {
+            error_code = tga_load(&data, &info, file_name);
+        } else {
+            error_code = tga_load_from_memory(&data, &info, buffer, size);
+        }
+        if (error_code != TGA_NO_ERROR) {
+            return -1.0;
+        }
+        decoded_size += (size_t)tga_get_image_width(info) *
+                        tga_get_image_height(info) *
+                        tga_get_bytes_per_pixel(info);
+        tga_free_data(data);
+        tga_free_info(info);
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    return decoded_size / (1024.0 * 1024.0) / seconds;
+}
+
+// Returns the throughput in MB/s of creating a large image and writing all of
+// its pixels, as the decoder does, or a negative value on failure.
+static double bench_create(int is_zeroed) {
+    const int size = 4096;
+    size_t data_size = (size_t)size * size * 4;
+    clock_t start = clock();
+    for (int i = 0; i < ITERATION_COUNT; i++) {
+        uint8_t *data;
+        tga_info *info;
+        enum tga_error error_code;
+        if (is_zeroed) {
+            error_code = tga_create(&data, &info, size, size, TGA_PIXEL_ARGB32);
+        } else {
+            error_code = tga_create_uninitialized(&data, &info, size, size,
+                                                  TGA_PIXEL_ARGB32);
+        }
+        if (error_code != TGA_NO_ERROR) {
+            return -1.0;
+        }
+        memset(data, i, data_size);
+        tga_free_data(data);
+        tga_free_info(info);
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    return data_size * ITERATION_COUNT / (1024.0 * 1024.0) / seconds;
+}
+
+// Returns the throughput in MB/s of rotating a large image by 90 degrees, or a
+// negative value on failure. The naive rotations copy the pixels one by one,
+// reading the source column by column, with tga_get_pixel() or with the
+// unchecked accessor of an image view.
+enum rotate_method { ROTATE_GET_PIXEL, ROTATE_VIEW, ROTATE_TILED };
+
+static double bench_rotate(enum rotate_method method) {
+    const int width = 4096;
+    const int height = 2048;
+    uint8_t *data;
+    tga_info *info;
+    if (tga_create(&data, &info, width, height, TGA_PIXEL_ARGB32) !=
+        TGA_NO_ERROR) {
+        return -1.0;
+    }
+    size_t data_size = (size_t)width * height * 4;
+    clock_t start = clock();
+    for (int i = 0; i < ITERATION_COUNT; i++) {
+        uint8_t *rotated;
+        tga_info *rotated_info;
+        if (method == ROTATE_GET_PIXEL) {
+            if (tga_create(&rotated, &rotated_info, height, width,
+                           TGA_PIXEL_ARGB32) != TGA_NO_ERROR) {
+                return -1.0;
+            }
+            for (int y = 0; y < width; y++) {
+                for (int x = 0; x < height; x++) {
+                    memcpy(tga_get_pixel(rotated, rotated_info, x, y),
+                           tga_get_pixel(data, info, y, height - 1 - x), 4);
+                }
+            }
+        } else if (method == ROTATE_VIEW) {
+            if (tga_create(&rotated, &rotated_info, height, width,
+                           TGA_PIXEL_ARGB32) != TGA_NO_ERROR) {
+                return -1.0;
+            }
+            struct tga_image_view source, dest;
+            tga_get_image_view(&source, data, info);
+            tga_get_image_view(&dest, rotated, rotated_info);
+            for (int y = 0; y < width; y++) {
+                uint8_t *row = tga_view_get_row(&dest, y);
+                for (int x = 0; x < height; x++) {
+                    memcpy(row + (size_t)x * 4,
+                           tga_get_pixel_unchecked(&source, y, height - 1 - x),
+                           4);
+                }
+            }
+        } else if (tga_image_rotate_90(&rotated, &rotated_info, data, info,
+                                       0) != TGA_NO_ERROR) {
+            return -1.0;
+        }
+        tga_free_image(rotated, rotated_info);
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    tga_free_data(data);
+    tga_free_info(info);
+    return data_size * ITERATION_COUNT / (1024.0 * 1024.0) / seconds;
+}
+
+// Returns the throughput in MB/s, counted on the converted data, of converting
+// a large image to TGA_PIXEL_ABGR32, or a negative value on failure.
+static double bench_convert(enum tga_pixel_format format) {
+    const int size = 4096;
+    uint8_t *data;
+    tga_info *info;
+    if (tga_create(&data, &info, size, size, format) != TGA_NO_ERROR) {
+        return -1.0;
+    }
+    size_t data_size = (size_t)size * size * 4;
+    clock_t start = clock();
+    for (int i = 0; i < ITERATION_COUNT; i++) {
+        uint8_t *converted;
+        tga_info *converted_info;
+        if (tga_convert(&converted, &converted_info, data, info,
+                        TGA_PIXEL_ABGR32) != TGA_NO_ERROR) {
+            return -1.0;
+        }
+        tga_free_image(converted, converted_info);
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    tga_free_image(data, info);
+    return data_size * ITERATION_COUNT / (1024.0 * 1024.0) / seconds;
+}
+
+int main(void) {
+    const char *image_name_list[] = {
+        "CBW8.TGA", "CCM8.TGA", "CTC16.TGA", "CTC24.TGA", "CTC32.TGA",
+        "UBW8.TGA", "UCM8.TGA", "UTC16.TGA", "UTC24.TGA", "UTC32.TGA"};
+    int image_count = sizeof(image_name_list) / sizeof(image_name_list[0]);
+
+    printf("%-10s %12s %12s\n", "Image", "File MB/s", "Memory MB/s");
+    for (int i = 0; i < image_count; i++) {
+        char source_name[128];
+        char scaled_name[128];
+        snprintf(source_name, sizeof(source_name), "images/%s",
+                 image_name_list[i]);
+        snprintf(scaled_name, sizeof(scaled_name), "bench_%s",
+                 image_name_list[i]);
+
+        struct scaled_image image;
+        if (create_scaled_image(&image, source_name) ||
+            write_file(scaled_name, image.buffer, image.size)) {
+            printf("Cannot create the scaled image of %s\n", source_name);
+            return 1;
+        }
+        double file_speed = bench_load(scaled_name, NULL, 0);
+        double memory_speed = bench_load(NULL, image.buffer, image.size);
+        printf("%-10s %12.1f %12.1f\n", image_name_list[i], file_speed,
+               memory_speed);
+        remove(scaled_name);
+        free(image.buffer);
+    }
+
+    // The decoder writes every pixel, so it skips the zero-fill of
+    // tga_create().
+    printf("\n%-30s %12s\n", "Create 4096x4096 ARGB32", "MB/s");
+    printf("%-30s %12.1f\n", "tga_create", bench_create(1));
+    printf("%-30s %12.1f\n", "tga_create_uninitialized", bench_create(0));
+
+    printf("\n%-30s %12s\n", "Rotate 4096x2048 ARGB32", "MB/s");
+    printf("%-30s %12.1f\n", "tga_get_pixel() loop",
+           bench_rotate(ROTATE_GET_PIXEL));
+    printf("%-30s %12.1f\n", "tga_get_pixel_unchecked() loop",
+           bench_rotate(ROTATE_VIEW));
+    printf("%-30s %12.1f\n", "tga_image_rotate_90", bench_rotate(ROTATE_TILED));
+
+    printf("\n%-30s %12s\n", "Convert 4096x4096 to ABGR32", "MB/s");
+    printf("%-30s %12.1f\n", "BW8", bench_convert(TGA_PIXEL_BW8));
+    printf("%-30s %12.1f\n", "RGB555", bench_convert(TGA_PIXEL_RGB555));
+    printf("%-30s %12.1f\n", "RGB24", bench_convert(TGA_PIXEL_RGB24));
+    return 0;
+}
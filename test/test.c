@@ -21,6 +21,8 @@
 // SOFTWARE.
 
 #include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -28,6 +30,10 @@
 
 #include "tgafunc.h"
 
+#ifdef TGAFUNC_TEST_THREADS
+#include <pthread.h>
+#endif
+
 static void create_test(void) {
     uint8_t *data;
     tga_info *info;
@@ -82,6 +88,19 @@ static void create_test(void) {
     }
     tga_free_data(data);
     tga_free_info(info);
+
+    // The uninitialized image is checked in the same way. The large image
+    // takes the aligned allocation path.
+    error_code = tga_create_uninitialized(&data, &info, 0, size, TGA_PIXEL_BW8);
+    assert(error_code == TGA_ERROR_INVALID_IMAGE_DIMENSIONS);
+    error_code = tga_create_uninitialized(&data, &info, 1024, 1024,
+                                          TGA_PIXEL_ARGB32);
+    assert(error_code == TGA_NO_ERROR);
+    assert(tga_get_image_width(info) == 1024);
+    assert(tga_get_pixel_format(info) == TGA_PIXEL_ARGB32);
+    memset(data, 0xFF, (size_t)1024 * 1024 * 4);
+    tga_free_data(data);
+    tga_free_info(info);
 }
 
 static void load_test(void) {
@@ -152,9 +171,1956 @@ static void load_test(void) {
     }
 }
 
+// Reads the whole file into a buffer allocated by malloc().
+static uint8_t *read_file(const char *file_name, size_t *size_out) {
+    FILE *file = fopen(file_name, "rb");
+    assert(file != NULL);
+    fseek(file, 0, SEEK_END);
+    size_t size = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *buffer = (uint8_t *)malloc(size);
+    assert(buffer != NULL);
+    size_t read_size = fread(buffer, 1, size, file);
+    assert(read_size == size);
+    fclose(file);
+    *size_out = size;
+    return buffer;
+}
+
+static void load_from_memory_test(void) {
+    const char *image_name_list[] = {
+        "images/CBW8.TGA", "images/CCM8.TGA",  "images/CTC16.TGA",
+        "images/CTC24.TGA", "images/CTC32.TGA", "images/UBW8.TGA",
+        "images/UCM8.TGA",  "images/UTC16.TGA", "images/UTC24.TGA",
+        "images/UTC32.TGA"};
+    int image_count = sizeof(image_name_list) / sizeof(image_name_list[0]);
+
+    for (int i = 0; i < image_count; i++) {
+        uint8_t *file_data, *memory_data;
+        tga_info *file_info, *memory_info;
+        enum tga_error error_code;
+        error_code = tga_load(&file_data, &file_info, image_name_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+
+        size_t buffer_size;
+        uint8_t *buffer = read_file(image_name_list[i], &buffer_size);
+        error_code = tga_load_from_memory(&memory_data, &memory_info, buffer,
+                                          buffer_size);
+        assert(error_code == TGA_NO_ERROR);
+        assert(tga_get_image_width(memory_info) ==
+               tga_get_image_width(file_info));
+        assert(tga_get_image_height(memory_info) ==
+               tga_get_image_height(file_info));
+        assert(tga_get_pixel_format(memory_info) ==
+               tga_get_pixel_format(file_info));
+        size_t data_size = (size_t)tga_get_image_width(file_info) *
+                           tga_get_image_height(file_info) *
+                           tga_get_bytes_per_pixel(file_info);
+        assert(memcmp(file_data, memory_data, data_size) == 0);
+        tga_free_data(memory_data);
+        tga_free_info(memory_info);
+        tga_free_data(file_data);
+        tga_free_info(file_info);
+
+        // A truncated buffer must not be read out of bounds.
+        error_code =
+            tga_load_from_memory(&memory_data, &memory_info, buffer, 100);
+        assert(error_code == TGA_ERROR_FILE_CANNOT_READ);
+        error_code =
+            tga_load_from_memory(&memory_data, &memory_info, buffer, 10);
+        assert(error_code == TGA_ERROR_FILE_CANNOT_READ);
+        free(buffer);
+    }
+
+    enum tga_error error_code;
+    uint8_t *data;
+    tga_info *info;
+    error_code = tga_load_from_memory(&data, &info, NULL, 0);
+    assert(error_code == TGA_ERROR_NO_DATA);
+}
+
+static void map_test(void) {
+    // UTC24.TGA can be used in place, CTC24.TGA has to be decoded.
+    const char *image_name_list[] = {"images/UTC24.TGA", "images/CTC24.TGA"};
+    const int zero_copy_list[] = {1, 0};
+
+    for (int i = 0; i < 2; i++) {
+        tga_mapped_image *image;
+        enum tga_error error_code = tga_map(&image, image_name_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+        assert(!tga_mapped_is_zero_copy(image) == !zero_copy_list[i]);
+
+        uint8_t *data;
+        tga_info *info;
+        error_code = tga_load(&data, &info, image_name_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+        const tga_info *mapped_info = tga_mapped_get_info(image);
+        int width = tga_get_image_width(mapped_info);
+        int height = tga_get_image_height(mapped_info);
+        assert(width == tga_get_image_width(info));
+        assert(height == tga_get_image_height(info));
+        assert(tga_get_pixel_format(mapped_info) == tga_get_pixel_format(info));
+
+        // Compares row by row, the mapped rows may be stored bottom up.
+        const uint8_t *mapped_data = tga_mapped_get_data(image);
+        int stride = tga_mapped_get_stride(image);
+        size_t row_size = (size_t)width * tga_get_bytes_per_pixel(info);
+        for (int y = 0; y < height; y++) {
+            const uint8_t *row = tga_get_pixel(data, info, 0, y);
+            assert(memcmp(mapped_data + y * stride, row, row_size) == 0);
+        }
+        tga_free_data(data);
+        tga_free_info(info);
+        tga_unmap(image);
+    }
+
+    tga_mapped_image *image;
+    enum tga_error error_code = tga_map(&image, "images/NOT_EXIST.TGA");
+    assert(error_code == TGA_ERROR_FILE_CANNOT_READ);
+}
+
+static void flip_test(void) {
+    const enum tga_pixel_format format_list[] = {
+        TGA_PIXEL_BW8, TGA_PIXEL_RGB555, TGA_PIXEL_RGB24, TGA_PIXEL_ARGB32};
+    const int width_list[] = {1, 2, 7, 37, 128};
+    const int height = 5;
+
+    for (int f = 0; f < 4; f++) {
+        for (int w = 0; w < 5; w++) {
+            int width = width_list[w];
+            uint8_t *data, *flipped;
+            tga_info *info, *flipped_info;
+            enum tga_error error_code;
+            error_code =
+                tga_create(&data, &info, width, height, format_list[f]);
+            assert(error_code == TGA_NO_ERROR);
+            error_code = tga_create(&flipped, &flipped_info, width, height,
+                                    format_list[f]);
+            assert(error_code == TGA_NO_ERROR);
+            int pixel_size = tga_get_bytes_per_pixel(info);
+            size_t data_size = (size_t)width * height * pixel_size;
+            for (size_t i = 0; i < data_size; i++) {
+                data[i] = (uint8_t)(i * 7 + 3);
+            }
+
+            memcpy(flipped, data, data_size);
+            tga_image_flip_h(flipped, flipped_info);
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    uint8_t *p1 = tga_get_pixel(data, info, x, y);
+                    uint8_t *p2 =
+                        tga_get_pixel(flipped, flipped_info, width - 1 - x, y);
+                    assert(memcmp(p1, p2, pixel_size) == 0);
+                }
+            }
+
+            memcpy(flipped, data, data_size);
+            tga_image_flip_v(flipped, flipped_info);
+            for (int y = 0; y < height; y++) {
+                uint8_t *p1 = tga_get_pixel(data, info, 0, y);
+                uint8_t *p2 =
+                    tga_get_pixel(flipped, flipped_info, 0, height - 1 - y);
+                assert(memcmp(p1, p2, (size_t)width * pixel_size) == 0);
+            }
+
+            tga_free_data(data);
+            tga_free_info(info);
+            tga_free_data(flipped);
+            tga_free_info(flipped_info);
+        }
+    }
+}
+
+static void orientation_test(void) {
+    // The image descriptor is the last byte of the header.
+    const int descriptor_offset = 17;
+    const char *image_name_list[] = {"images/UTC24.TGA", "images/CTC24.TGA",
+                                     "images/UCM8.TGA", "images/CBW8.TGA"};
+
+    for (int i = 0; i < 4; i++) {
+        uint8_t *data;
+        tga_info *info;
+        enum tga_error error_code = tga_load(&data, &info, image_name_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+        size_t data_size = (size_t)tga_get_image_width(info) *
+                           tga_get_image_height(info) *
+                           tga_get_bytes_per_pixel(info);
+        size_t buffer_size;
+        uint8_t *buffer = read_file(image_name_list[i], &buffer_size);
+        // The test images are stored from bottom to top and from left to
+        // right. Changes the origin to the other corners, the loaded image
+        // should be flipped accordingly.
+        uint8_t descriptor = buffer[descriptor_offset];
+        for (int corner = 1; corner < 4; corner++) {
+            bool right_to_left = corner & 0x1;
+            bool top_to_bottom = corner & 0x2;
+            buffer[descriptor_offset] = descriptor |
+                                        (right_to_left ? 0x10 : 0) |
+                                        (top_to_bottom ? 0x20 : 0);
+            uint8_t *flipped;
+            tga_info *flipped_info;
+            error_code = tga_load_from_memory(&flipped, &flipped_info, buffer,
+                                              buffer_size);
+            assert(error_code == TGA_NO_ERROR);
+            if (right_to_left) {
+                tga_image_flip_h(flipped, flipped_info);
+            }
+            if (top_to_bottom) {
+                tga_image_flip_v(flipped, flipped_info);
+            }
+            assert(memcmp(data, flipped, data_size) == 0);
+            tga_free_data(flipped);
+            tga_free_info(flipped_info);
+        }
+        free(buffer);
+        tga_free_data(data);
+        tga_free_info(info);
+    }
+}
+
+static void color_map_index_test(void) {
+    const char *image_name_list[] = {"images/UCM8.TGA", "images/CCM8.TGA"};
+
+    for (int i = 0; i < 2; i++) {
+        size_t buffer_size;
+        uint8_t *buffer = read_file(image_name_list[i], &buffer_size);
+        // Moves the first entry index of the color map, the indices lower
+        // than it are not in the color map.
+        buffer[3] = 200;
+        uint8_t *data;
+        tga_info *info;
+        enum tga_error error_code =
+            tga_load_from_memory(&data, &info, buffer, buffer_size);
+        assert(error_code == TGA_ERROR_COLOR_MAP_INDEX_FAILED);
+        free(buffer);
+    }
+}
+
+static void keep_color_map_test(void) {
+    const char *image_name_list[] = {"images/UCM8.TGA", "images/CCM8.TGA"};
+    const char save_name[] = "indexed_test.tga";
+    struct tga_load_options options = {0};
+    options.flags = TGA_LOAD_KEEP_COLOR_MAP;
+
+    for (int i = 0; i < 2; i++) {
+        uint8_t *data, *indices;
+        tga_info *info, *indexed_info;
+        enum tga_error error_code = tga_load(&data, &info, image_name_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+        assert(tga_get_color_map(info) == NULL);
+        error_code = tga_load_with_options(&indices, &indexed_info,
+                                           image_name_list[i], &options);
+        assert(error_code == TGA_NO_ERROR);
+        assert(tga_get_pixel_format(indexed_info) == TGA_PIXEL_INDEX8);
+        assert(tga_get_bytes_per_pixel(indexed_info) == 1);
+        assert(tga_get_color_map_first_index(indexed_info) == 0);
+        assert(tga_get_color_map_length(indexed_info) == 256);
+        assert(tga_get_color_map_entry_size(indexed_info) == 2);
+
+        // Expands the indices, should be the same as the default loading.
+        const uint8_t *color_map = tga_get_color_map(indexed_info);
+        int width = tga_get_image_width(indexed_info);
+        int height = tga_get_image_height(indexed_info);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                uint8_t index = *tga_get_pixel(indices, indexed_info, x, y);
+                uint8_t *pixel = tga_get_pixel(data, info, x, y);
+                assert(memcmp(pixel, color_map + index * 2, 2) == 0);
+            }
+        }
+
+        // The saved indexed image keeps the color map.
+        remove(save_name);
+        error_code = tga_save_from_info(indices, indexed_info, save_name);
+        assert(error_code == TGA_NO_ERROR);
+        uint8_t *saved_data;
+        tga_info *saved_info;
+        error_code = tga_load(&saved_data, &saved_info, save_name);
+        assert(error_code == TGA_NO_ERROR);
+        assert(tga_get_pixel_format(saved_info) == TGA_PIXEL_RGB555);
+        assert(memcmp(saved_data, data, (size_t)width * height * 2) == 0);
+        remove(save_name);
+
+        tga_free_data(saved_data);
+        tga_free_info(saved_info);
+        tga_free_data(indices);
+        tga_free_info(indexed_info);
+        tga_free_data(data);
+        tga_free_info(info);
+    }
+
+    // An indexed image without color map cannot be saved.
+    uint8_t *data;
+    tga_info *info;
+    enum tga_error error_code =
+        tga_create(&data, &info, 4, 4, TGA_PIXEL_INDEX8);
+    assert(error_code == TGA_NO_ERROR);
+    error_code = tga_save_from_info(data, info, save_name);
+    assert(error_code == TGA_ERROR_UNSUPPORTED_PIXEL_FORMAT);
+    tga_free_data(data);
+    tga_free_info(info);
+}
+
+// Returns the byte size of the file.
+static long get_file_size(const char *file_name) {
+    FILE *file = fopen(file_name, "rb");
+    assert(file != NULL);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+static void save_rle_test(void) {
+    const char *image_name_list[] = {"images/UBW8.TGA", "images/UTC16.TGA",
+                                     "images/UTC24.TGA", "images/UTC32.TGA"};
+    const char save_name[] = "rle_test.tga";
+    struct tga_save_options options = {0};
+    options.flags = TGA_SAVE_RLE;
+
+    // The saved RLE images should be loaded as the same as the source images.
+    for (int i = 0; i < 4; i++) {
+        uint8_t *data, *saved_data;
+        tga_info *info, *saved_info;
+        enum tga_error error_code = tga_load(&data, &info, image_name_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+        remove(save_name);
+        error_code = tga_save_with_options(data, info, save_name, &options);
+        assert(error_code == TGA_NO_ERROR);
+        error_code = tga_load(&saved_data, &saved_info, save_name);
+        assert(error_code == TGA_NO_ERROR);
+        assert(tga_get_pixel_format(saved_info) == tga_get_pixel_format(info));
+        size_t data_size = (size_t)tga_get_image_width(info) *
+                           tga_get_image_height(info) *
+                           tga_get_bytes_per_pixel(info);
+        assert(memcmp(data, saved_data, data_size) == 0);
+        remove(save_name);
+        tga_free_data(saved_data);
+        tga_free_info(saved_info);
+        tga_free_data(data);
+        tga_free_info(info);
+    }
+
+    // Run and raw packets with all pixel sizes, longer than a packet.
+    const enum tga_pixel_format format_list[] = {
+        TGA_PIXEL_BW8, TGA_PIXEL_RGB555, TGA_PIXEL_RGB24, TGA_PIXEL_ARGB32};
+    const int width = 300, height = 4;
+    for (int i = 0; i < 4; i++) {
+        uint8_t *data, *saved_data;
+        tga_info *info, *saved_info;
+        enum tga_error error_code =
+            tga_create(&data, &info, width, height, format_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+        int pixel_size = tga_get_bytes_per_pixel(info);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                // Unique pixels on the odd rows, and the runs of different
+                // lengths on the even rows.
+                int value = y % 2 ? x : x / (y + 3);
+                uint8_t *pixel = tga_get_pixel(data, info, x, y);
+                for (int k = 0; k < pixel_size; k++) {
+                    pixel[k] = (uint8_t)(value >> (k * 2));
+                }
+            }
+        }
+        remove(save_name);
+        error_code = tga_save_with_options(data, info, save_name, &options);
+        assert(error_code == TGA_NO_ERROR);
+        error_code = tga_load(&saved_data, &saved_info, save_name);
+        assert(error_code == TGA_NO_ERROR);
+        size_t data_size = (size_t)width * height * pixel_size;
+        assert(memcmp(data, saved_data, data_size) == 0);
+        remove(save_name);
+        tga_free_data(saved_data);
+        tga_free_info(saved_info);
+
+        // A flat image has one packet per scanline, as the packets do not
+        // cross scanlines.
+        memset(data, 0x5A, data_size);
+        tga_info *flat_info;
+        uint8_t *flat_data;
+        error_code = tga_create(&flat_data, &flat_info, 100, height,
+                                format_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+        memset(flat_data, 0x5A, (size_t)100 * height * pixel_size);
+        error_code =
+            tga_save_with_options(flat_data, flat_info, save_name, &options);
+        assert(error_code == TGA_NO_ERROR);
+        assert(get_file_size(save_name) == 18 + height * (1 + pixel_size));
+        remove(save_name);
+        tga_free_data(flat_data);
+        tga_free_info(flat_info);
+        tga_free_data(data);
+        tga_free_info(info);
+    }
+}
+
+static void reader_test(void) {
+    const char *image_name_list[] = {
+        "images/CBW8.TGA", "images/CCM8.TGA",  "images/CTC16.TGA",
+        "images/CTC24.TGA", "images/CTC32.TGA", "images/UBW8.TGA",
+        "images/UCM8.TGA",  "images/UTC16.TGA", "images/UTC24.TGA",
+        "images/UTC32.TGA"};
+    int image_count = sizeof(image_name_list) / sizeof(image_name_list[0]);
+    // Reads an odd number of scanlines each time, so that the RLE packets
+    // cross the reads.
+    const int block_rows = 7;
+
+    for (int i = 0; i < image_count; i++) {
+        uint8_t *data;
+        tga_info *info;
+        enum tga_error error_code = tga_load(&data, &info, image_name_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+
+        tga_reader *reader;
+        error_code = tga_reader_open(&reader, image_name_list[i], NULL);
+        assert(error_code == TGA_NO_ERROR);
+        const tga_info *reader_info = tga_reader_get_info(reader);
+        int width = tga_get_image_width(reader_info);
+        int height = tga_get_image_height(reader_info);
+        assert(width == tga_get_image_width(info));
+        assert(height == tga_get_image_height(info));
+        assert(tga_get_pixel_format(reader_info) == tga_get_pixel_format(info));
+        // All the test images are stored from bottom to top.
+        assert(tga_reader_is_bottom_up(reader));
+
+        size_t row_size = (size_t)width * tga_get_bytes_per_pixel(info);
+        uint8_t *rows = (uint8_t *)malloc(row_size * block_rows);
+        int row_index = 0;
+        while (tga_reader_get_remaining_rows(reader) > 0) {
+            int count = tga_reader_get_remaining_rows(reader);
+            count = count < block_rows ? count : block_rows;
+            error_code = tga_read_scanlines(reader, rows, count);
+            assert(error_code == TGA_NO_ERROR);
+            for (int k = 0; k < count; k++, row_index++) {
+                const uint8_t *row =
+                    tga_get_pixel(data, info, 0, height - 1 - row_index);
+                assert(memcmp(rows + row_size * k, row, row_size) == 0);
+            }
+        }
+        assert(row_index == height);
+        error_code = tga_read_scanlines(reader, rows, 1);
+        assert(error_code == TGA_ERROR_NO_DATA);
+        free(rows);
+        tga_reader_close(reader);
+        tga_free_data(data);
+        tga_free_info(info);
+    }
+}
+
+static void writer_test(void) {
+    const char *image_name_list[] = {"images/UCM8.TGA", "images/UTC24.TGA"};
+    const char save_name[] = "writer_test.tga";
+    const int band_rows = 10;
+
+    for (int i = 0; i < 2; i++) {
+        for (int rle = 0; rle < 2; rle++) {
+            struct tga_load_options load_options = {0};
+            load_options.flags = TGA_LOAD_KEEP_COLOR_MAP;
+            uint8_t *data;
+            tga_info *info;
+            enum tga_error error_code = tga_load_with_options(
+                &data, &info, image_name_list[i], &load_options);
+            assert(error_code == TGA_NO_ERROR);
+            int height = tga_get_image_height(info);
+            size_t row_size = (size_t)tga_get_image_width(info) *
+                              tga_get_bytes_per_pixel(info);
+
+            // Writes the image in bands, with a buffer smaller than a band.
+            struct tga_save_options options = {0};
+            options.flags = rle ? TGA_SAVE_RLE : 0;
+            options.buffer_size = 100;
+            tga_writer *writer;
+            remove(save_name);
+            error_code =
+                tga_writer_open_from_info(&writer, info, save_name, &options);
+            assert(error_code == TGA_NO_ERROR);
+            for (int y = 0; y < height; y += band_rows) {
+                int count = height - y < band_rows ? height - y : band_rows;
+                error_code =
+                    tga_write_scanlines(writer, data + row_size * y, count);
+                assert(error_code == TGA_NO_ERROR);
+            }
+            error_code = tga_write_scanlines(writer, data, 1);
+            assert(error_code == TGA_ERROR_NO_DATA);
+            error_code = tga_writer_close(writer);
+            assert(error_code == TGA_NO_ERROR);
+
+            uint8_t *saved_data;
+            tga_info *saved_info;
+            error_code = tga_load_with_options(&saved_data, &saved_info,
+                                               save_name, &load_options);
+            assert(error_code == TGA_NO_ERROR);
+            assert(memcmp(data, saved_data, row_size * height) == 0);
+            remove(save_name);
+            tga_free_data(saved_data);
+            tga_free_info(saved_info);
+            tga_free_data(data);
+            tga_free_info(info);
+        }
+    }
+
+    // An incomplete image is not kept.
+    tga_writer *writer;
+    enum tga_error error_code =
+        tga_writer_open(&writer, 4, 4, TGA_PIXEL_BW8, save_name, NULL);
+    assert(error_code == TGA_NO_ERROR);
+    uint8_t row[4] = {0};
+    error_code = tga_write_scanlines(writer, row, 1);
+    assert(error_code == TGA_NO_ERROR);
+    error_code = tga_writer_close(writer);
+    assert(error_code == TGA_ERROR_NO_DATA);
+    FILE *file = fopen(save_name, "rb");
+    assert(file == NULL);
+}
+
+static void parallel_load_test(void) {
+    const char *image_name_list[] = {
+        "images/CBW8.TGA", "images/CCM8.TGA",  "images/CTC16.TGA",
+        "images/CTC24.TGA", "images/CTC32.TGA", "images/UBW8.TGA",
+        "images/UCM8.TGA",  "images/UTC16.TGA", "images/UTC24.TGA",
+        "images/UTC32.TGA"};
+    int image_count = sizeof(image_name_list) / sizeof(image_name_list[0]);
+    struct tga_load_options options = {0};
+    options.thread_count = 4;
+
+    for (int i = 0; i < image_count; i++) {
+        uint8_t *data, *parallel_data;
+        tga_info *info, *parallel_info;
+        enum tga_error error_code;
+        error_code = tga_load(&data, &info, image_name_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+        size_t data_size = (size_t)tga_get_image_width(info) *
+                           tga_get_image_height(info) *
+                           tga_get_bytes_per_pixel(info);
+
+        error_code = tga_load_with_options(&parallel_data, &parallel_info,
+                                           image_name_list[i], &options);
+        assert(error_code == TGA_NO_ERROR);
+        assert(memcmp(data, parallel_data, data_size) == 0);
+        tga_free_data(parallel_data);
+        tga_free_info(parallel_info);
+
+        size_t buffer_size;
+        uint8_t *buffer = read_file(image_name_list[i], &buffer_size);
+        error_code = tga_load_from_memory_with_options(
+            &parallel_data, &parallel_info, buffer, buffer_size, &options);
+        assert(error_code == TGA_NO_ERROR);
+        assert(memcmp(data, parallel_data, data_size) == 0);
+        tga_free_data(parallel_data);
+        tga_free_info(parallel_info);
+
+        // The thread count is only a maximum, any value is valid.
+        struct tga_load_options max_options = {0};
+        max_options.thread_count = INT_MAX;
+        error_code = tga_load_from_memory_with_options(
+            &parallel_data, &parallel_info, buffer, buffer_size, &max_options);
+        assert(error_code == TGA_NO_ERROR);
+        assert(memcmp(data, parallel_data, data_size) == 0);
+        tga_free_data(parallel_data);
+        tga_free_info(parallel_info);
+
+        // The truncated data is copied to a buffer of its exact size, so that
+        // reading past its end is detected by the sanitizers. The files have
+        // extension areas after the pixels, 1000 bytes cut into the pixels of
+        // every image.
+        const size_t truncated_size = 1000;
+        uint8_t *truncated = (uint8_t *)malloc(truncated_size);
+        assert(truncated != NULL);
+        memcpy(truncated, buffer, truncated_size);
+        error_code = tga_load_from_memory_with_options(
+            &parallel_data, &parallel_info, truncated, truncated_size,
+            &options);
+        assert(error_code == TGA_ERROR_FILE_CANNOT_READ);
+        free(truncated);
+
+        // The same for a truncated file, which is decoded from its mapping.
+        const char *truncated_name = "test_truncated.tga";
+        FILE *file = fopen(truncated_name, "wb");
+        assert(file != NULL);
+        assert(fwrite(buffer, 1, truncated_size, file) == truncated_size);
+        fclose(file);
+        error_code = tga_load_with_options(&parallel_data, &parallel_info,
+                                           truncated_name, &options);
+        assert(error_code == TGA_ERROR_FILE_CANNOT_READ);
+        remove(truncated_name);
+        free(buffer);
+        tga_free_data(data);
+        tga_free_info(info);
+    }
+
+    // The packets of this image cross the scanlines and the bands: a run
+    // length packet of 20 pixels and a raw packet of 7 pixels alternately.
+    const int width = 3, height = 64;
+    uint8_t buffer[1024] = {0};
+    buffer[2] = 10;
+    buffer[12] = width;
+    buffer[14] = height;
+    buffer[16] = 24;
+    size_t size = 18;
+    int pixel_count = width * height;
+    for (int n = 0; pixel_count > 0; n++) {
+        int count = n % 2 ? 7 : 20;
+        if (count > pixel_count) {
+            count = pixel_count;
+        }
+        bool is_run_length = n % 2 == 0;
+        buffer[size++] = (uint8_t)((count - 1) | (is_run_length ? 0x80 : 0));
+        for (int k = 0; k < (is_run_length ? 1 : count); k++) {
+            buffer[size++] = (uint8_t)n;
+            buffer[size++] = (uint8_t)k;
+            buffer[size++] = (uint8_t)(n + k);
+        }
+        pixel_count -= count;
+    }
+    uint8_t *data, *parallel_data;
+    tga_info *info, *parallel_info;
+    enum tga_error error_code =
+        tga_load_from_memory(&data, &info, buffer, size);
+    assert(error_code == TGA_NO_ERROR);
+    error_code = tga_load_from_memory_with_options(
+        &parallel_data, &parallel_info, buffer, size, &options);
+    assert(error_code == TGA_NO_ERROR);
+    assert(memcmp(data, parallel_data, (size_t)width * height * 3) == 0);
+    tga_free_data(parallel_data);
+    tga_free_info(parallel_info);
+    tga_free_data(data);
+    tga_free_info(info);
+}
+
+#define BATCH_ITEM_COUNT 12
+
+struct batch_test_context {
+    struct tga_batch_item *items;
+    // Each item sets only its own slot, so no lock is needed.
+    int callback_count[BATCH_ITEM_COUNT];
+};
+
+static void batch_test_callback(struct tga_batch_item *item, void *user_data) {
+    struct batch_test_context *context =
+        (struct batch_test_context *)user_data;
+    context->callback_count[item - context->items]++;
+}
+
+static void batch_test(void) {
+    const char *image_name_list[] = {
+        "images/CBW8.TGA", "images/CCM8.TGA",  "images/CTC16.TGA",
+        "images/CTC24.TGA", "images/CTC32.TGA", "images/UBW8.TGA",
+        "images/UCM8.TGA",  "images/UTC16.TGA", "images/UTC24.TGA",
+        "images/UTC32.TGA"};
+    int image_count = sizeof(image_name_list) / sizeof(image_name_list[0]);
+
+    // The images from files, one from memory and a file that does not exist.
+    struct tga_batch_item items[BATCH_ITEM_COUNT];
+    memset(items, 0, sizeof(items));
+    for (int i = 0; i < image_count; i++) {
+        items[i].file_name = image_name_list[i];
+    }
+    size_t buffer_size;
+    uint8_t *buffer = read_file("images/CTC24.TGA", &buffer_size);
+    items[image_count].buffer = buffer;
+    items[image_count].size = buffer_size;
+    items[image_count + 1].file_name = "images/NOT_EXIST.TGA";
+
+    for (int thread_count = 1; thread_count <= 4; thread_count += 3) {
+        struct batch_test_context context;
+        memset(&context, 0, sizeof(context));
+        context.items = items;
+        struct tga_batch_options options = {0};
+        options.thread_count = thread_count;
+        options.callback = batch_test_callback;
+        options.user_data = &context;
+        enum tga_error error_code =
+            tga_load_batch(items, BATCH_ITEM_COUNT, &options);
+        assert(error_code == TGA_ERROR_FILE_CANNOT_READ);
+
+        for (int i = 0; i < BATCH_ITEM_COUNT; i++) {
+            assert(context.callback_count[i] == 1);
+            const char *file_name =
+                i < image_count ? image_name_list[i] : "images/CTC24.TGA";
+            if (i == image_count + 1) {
+                assert(items[i].error_code == TGA_ERROR_FILE_CANNOT_READ);
+                assert(items[i].data == NULL && items[i].info == NULL);
+                continue;
+            }
+            assert(items[i].error_code == TGA_NO_ERROR);
+            uint8_t *data;
+            tga_info *info;
+            error_code = tga_load(&data, &info, file_name);
+            assert(error_code == TGA_NO_ERROR);
+            size_t data_size = (size_t)tga_get_image_width(info) *
+                               tga_get_image_height(info) *
+                               tga_get_bytes_per_pixel(info);
+            assert(memcmp(items[i].data, data, data_size) == 0);
+            tga_free_data(data);
+            tga_free_info(info);
+            tga_free_data(items[i].data);
+            tga_free_info(items[i].info);
+        }
+    }
+    free(buffer);
+
+    enum tga_error error_code = tga_load_batch(NULL, 0, NULL);
+    assert(error_code == TGA_ERROR_NO_DATA);
+}
+
+static void loader_test(void) {
+    const char *image_name_list[] = {
+        "images/CBW8.TGA", "images/CCM8.TGA",  "images/CTC16.TGA",
+        "images/CTC24.TGA", "images/CTC32.TGA", "images/UBW8.TGA",
+        "images/UCM8.TGA",  "images/UTC16.TGA", "images/UTC24.TGA",
+        "images/UTC32.TGA", "images/NOT_EXIST.TGA"};
+    const int image_count =
+        sizeof(image_name_list) / sizeof(image_name_list[0]);
+
+    size_t buffer_size;
+    uint8_t *buffer = read_file("images/CTC24.TGA", &buffer_size);
+    for (int thread_count = 0; thread_count <= 3; thread_count += 3) {
+        tga_loader *loader;
+        enum tga_error error_code = tga_loader_create(&loader, thread_count);
+        assert(error_code == TGA_NO_ERROR);
+
+        // Submits all loads before waiting for any of them.
+        tga_load_request *requests[16];
+        for (int i = 0; i < image_count; i++) {
+            error_code = tga_loader_submit(loader, &requests[i],
+                                           image_name_list[i], NULL);
+            assert(error_code == TGA_NO_ERROR);
+        }
+        error_code = tga_loader_submit_memory(loader, &requests[image_count],
+                                              buffer, buffer_size, NULL);
+        assert(error_code == TGA_NO_ERROR);
+
+        for (int i = 0; i <= image_count; i++) {
+            const char *file_name =
+                i < image_count ? image_name_list[i] : "images/CTC24.TGA";
+            uint8_t *expected_data;
+            tga_info *expected_info;
+            enum tga_error expected_error_code =
+                tga_load(&expected_data, &expected_info, file_name);
+
+            uint8_t *data;
+            tga_info *info;
+            error_code = tga_load_wait(requests[i], &data, &info);
+            assert(error_code == expected_error_code);
+            if (error_code != TGA_NO_ERROR) {
+                continue;
+            }
+            size_t data_size = (size_t)tga_get_image_width(info) *
+                               tga_get_image_height(info) *
+                               tga_get_bytes_per_pixel(info);
+            assert(memcmp(data, expected_data, data_size) == 0);
+            tga_free_data(data);
+            tga_free_info(info);
+            tga_free_data(expected_data);
+            tga_free_info(expected_info);
+        }
+
+        // The load is done eventually.
+        tga_load_request *request;
+        error_code =
+            tga_loader_submit(loader, &request, "images/UTC32.TGA", NULL);
+        assert(error_code == TGA_NO_ERROR);
+        while (!tga_load_poll(request)) {
+        }
+        uint8_t *data;
+        tga_info *info;
+        error_code = tga_load_wait(request, &data, &info);
+        assert(error_code == TGA_NO_ERROR);
+        tga_free_data(data);
+        tga_free_info(info);
+        tga_loader_destroy(loader);
+    }
+    free(buffer);
+}
+
+static void probe_test(void) {
+    const char *image_name_list[] = {
+        "images/CBW8.TGA", "images/CCM8.TGA",  "images/CTC16.TGA",
+        "images/CTC24.TGA", "images/CTC32.TGA", "images/UBW8.TGA",
+        "images/UCM8.TGA",  "images/UTC16.TGA", "images/UTC24.TGA",
+        "images/UTC32.TGA"};
+    int image_count = sizeof(image_name_list) / sizeof(image_name_list[0]);
+    const char image_id[] = "Truevision(R) Sample Image";
+
+    for (int i = 0; i < image_count; i++) {
+        uint8_t *data;
+        tga_info *info;
+        enum tga_error error_code = tga_load(&data, &info, image_name_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+
+        struct tga_header_info header;
+        error_code = tga_probe(&header, image_name_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+        assert(header.width == tga_get_image_width(info));
+        assert(header.height == tga_get_image_height(info));
+        assert(header.pixel_format == tga_get_pixel_format(info));
+        // The names of the compressed images start with "C".
+        bool is_rle = image_name_list[i][7] == 'C';
+        assert(header.is_rle == is_rle);
+        assert(header.is_color_mapped == (strstr(image_name_list[i], "CM8") !=
+                                          NULL));
+        assert(header.is_bottom_up);
+        assert(header.id_length == (int)strlen(image_id));
+        assert(memcmp(header.id, image_id, header.id_length) == 0);
+
+        // Only the header and the ID field are needed in memory.
+        size_t buffer_size;
+        uint8_t *buffer = read_file(image_name_list[i], &buffer_size);
+        struct tga_header_info memory_header;
+        error_code = tga_probe_memory(&memory_header, buffer,
+                                      18 + header.id_length);
+        assert(error_code == TGA_NO_ERROR);
+        assert(memory_header.width == header.width);
+        assert(memory_header.height == header.height);
+        assert(memory_header.pixel_format == header.pixel_format);
+        assert(memory_header.image_type == header.image_type);
+        assert(memory_header.pixel_depth == header.pixel_depth);
+        assert(memory_header.alpha_bits == header.alpha_bits);
+        assert(memory_header.map_length == header.map_length);
+        assert(memcmp(memory_header.id, header.id, sizeof(header.id)) == 0);
+        error_code = tga_probe_memory(&memory_header, buffer, 20);
+        assert(error_code == TGA_ERROR_FILE_CANNOT_READ);
+        free(buffer);
+        tga_free_data(data);
+        tga_free_info(info);
+    }
+
+    struct tga_header_info header;
+    enum tga_error error_code = tga_probe(&header, "images/NOT_EXIST.TGA");
+    assert(error_code == TGA_ERROR_FILE_CANNOT_READ);
+    error_code = tga_probe_memory(&header, NULL, 0);
+    assert(error_code == TGA_ERROR_NO_DATA);
+}
+
+// Counts the blocks that have not been released.
+static void *counting_alloc(void *user_data, size_t size) {
+    void *ptr = malloc(size);
+    if (ptr != NULL) {
+        (*(int *)user_data)++;
+    }
+    return ptr;
+}
+
+static void counting_release(void *user_data, void *ptr) {
+    if (ptr != NULL) {
+        (*(int *)user_data)--;
+    }
+    free(ptr);
+}
+
+static void allocator_test(void) {
+    const char *image_name_list[] = {
+        "images/CBW8.TGA", "images/CCM8.TGA",  "images/CTC16.TGA",
+        "images/CTC24.TGA", "images/CTC32.TGA", "images/UBW8.TGA",
+        "images/UCM8.TGA",  "images/UTC16.TGA", "images/UTC24.TGA",
+        "images/UTC32.TGA"};
+    int image_count = sizeof(image_name_list) / sizeof(image_name_list[0]);
+
+    int block_count = 0;
+    struct tga_allocator allocator = {counting_alloc, counting_release,
+                                      &block_count};
+    for (int i = 0; i < image_count; i++) {
+        uint8_t *data;
+        tga_info *info;
+        enum tga_error error_code = tga_load(&data, &info, image_name_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+        size_t data_size = (size_t)tga_get_image_width(info) *
+                           tga_get_image_height(info) *
+                           tga_get_bytes_per_pixel(info);
+
+        // Both the expanded and the indexed color mapped images, with the
+        // serial and the parallel decoding.
+        for (int n = 0; n < 2; n++) {
+            struct tga_load_options options = {0};
+            options.flags = n ? TGA_LOAD_KEEP_COLOR_MAP : 0;
+            options.thread_count = n ? 4 : 0;
+            options.allocator = &allocator;
+            uint8_t *allocated_data;
+            tga_info *allocated_info;
+            error_code = tga_load_with_options(&allocated_data,
+                                               &allocated_info,
+                                               image_name_list[i], &options);
+            assert(error_code == TGA_NO_ERROR);
+            assert(block_count > 0);
+            if (tga_get_pixel_format(allocated_info) != TGA_PIXEL_INDEX8) {
+                assert(memcmp(data, allocated_data, data_size) == 0);
+            }
+            tga_free_image(allocated_data, allocated_info);
+            assert(block_count == 0);
+        }
+        tga_free_data(data);
+        tga_free_info(info);
+    }
+
+    uint8_t *data;
+    tga_info *info;
+    enum tga_error error_code = tga_create_with_allocator(
+        &data, &info, 4, 4, TGA_PIXEL_RGB24, &allocator);
+    assert(error_code == TGA_NO_ERROR);
+    assert(block_count == 2);
+    assert(data[0] == 0 && data[4 * 4 * 3 - 1] == 0);
+    tga_free_image(data, info);
+    assert(block_count == 0);
+
+    // All images of a batch are loaded into one arena.
+    tga_arena *arena;
+    error_code = tga_arena_create(&arena, 4 * 1024 * 1024);
+    assert(error_code == TGA_NO_ERROR);
+    struct tga_allocator arena_allocator;
+    tga_arena_get_allocator(arena, &arena_allocator);
+    struct tga_load_options load_options = {0};
+    load_options.allocator = &arena_allocator;
+    struct tga_batch_item items[10];
+    memset(items, 0, sizeof(items));
+    for (int i = 0; i < image_count; i++) {
+        items[i].file_name = image_name_list[i];
+    }
+    struct tga_batch_options batch_options = {0};
+    batch_options.load_options = &load_options;
+    batch_options.thread_count = 4;
+    for (int n = 0; n < 2; n++) {
+        error_code = tga_load_batch(items, image_count, &batch_options);
+        assert(error_code == TGA_NO_ERROR);
+        assert(tga_arena_get_used_size(arena) > 0);
+        for (int i = 0; i < image_count; i++) {
+            error_code = tga_load(&data, &info, image_name_list[i]);
+            assert(error_code == TGA_NO_ERROR);
+            size_t data_size = (size_t)tga_get_image_width(info) *
+                               tga_get_image_height(info) *
+                               tga_get_bytes_per_pixel(info);
+            assert(memcmp(data, items[i].data, data_size) == 0);
+            tga_free_data(data);
+            tga_free_info(info);
+        }
+        tga_arena_reset(arena);
+        assert(tga_arena_get_used_size(arena) == 0);
+    }
+
+    // The arena is too small for the image.
+    tga_arena_destroy(arena);
+    error_code = tga_arena_create(&arena, 1024);
+    assert(error_code == TGA_NO_ERROR);
+    tga_arena_get_allocator(arena, &arena_allocator);
+    error_code = tga_load_with_options(&data, &info, "images/UTC32.TGA",
+                                       &load_options);
+    assert(error_code == TGA_ERROR_OUT_OF_MEMORY);
+    tga_arena_destroy(arena);
+}
+
+static void load_into_test(void) {
+    const char *image_name_list[] = {
+        "images/CBW8.TGA", "images/CCM8.TGA",  "images/CTC16.TGA",
+        "images/CTC24.TGA", "images/CTC32.TGA", "images/UBW8.TGA",
+        "images/UCM8.TGA",  "images/UTC16.TGA", "images/UTC24.TGA",
+        "images/UTC32.TGA"};
+    int image_count = sizeof(image_name_list) / sizeof(image_name_list[0]);
+    const uint8_t fill_value = 0xAB;
+
+    for (int i = 0; i < image_count; i++) {
+        uint8_t *data;
+        tga_info *info;
+        enum tga_error error_code = tga_load(&data, &info, image_name_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+        int width = tga_get_image_width(info);
+        int height = tga_get_image_height(info);
+        int pixel_size = tga_get_bytes_per_pixel(info);
+        size_t row_size = (size_t)width * pixel_size;
+
+        // The image is placed at (3,2) of a larger buffer with padded rows.
+        struct tga_destination destination;
+        destination.width = width + 5;
+        destination.height = height + 3;
+        destination.stride = (size_t)destination.width * pixel_size + 7;
+        destination.x = 3;
+        destination.y = 2;
+        size_t buffer_size = destination.stride * destination.height;
+        destination.data = (uint8_t *)malloc(buffer_size);
+        assert(destination.data != NULL);
+        uint8_t *image_data = destination.data + destination.stride * 2 +
+                              (size_t)3 * pixel_size;
+
+        size_t file_size;
+        uint8_t *file_data = read_file(image_name_list[i], &file_size);
+        for (int n = 0; n < 3; n++) {
+            memset(destination.data, fill_value, buffer_size);
+            struct tga_load_options options = {0};
+            options.thread_count = 4;
+            tga_info *loaded_info = NULL;
+            if (n == 0) {
+                error_code = tga_load_into(&destination, &loaded_info,
+                                           image_name_list[i], NULL);
+            } else if (n == 1) {
+                error_code = tga_load_into(&destination, NULL,
+                                           image_name_list[i], &options);
+            } else {
+                error_code = tga_load_from_memory_into(
+                    &destination, &loaded_info, file_data, file_size,
+                    &options);
+            }
+            assert(error_code == TGA_NO_ERROR);
+            if (loaded_info != NULL) {
+                assert(tga_get_image_width(loaded_info) == width);
+                assert(tga_get_pixel_format(loaded_info) ==
+                       tga_get_pixel_format(info));
+                tga_free_info(loaded_info);
+            }
+            for (size_t k = 0; k < buffer_size; k++) {
+                size_t row = k / destination.stride;
+                size_t column = k % destination.stride;
+                bool is_image = row >= 2 && row < (size_t)height + 2 &&
+                                column >= (size_t)3 * pixel_size &&
+                                column < (size_t)3 * pixel_size + row_size;
+                if (is_image) {
+                    size_t offset =
+                        row_size * (row - 2) + column - 3 * pixel_size;
+                    assert(destination.data[k] == data[offset]);
+                } else {
+                    assert(destination.data[k] == fill_value);
+                }
+            }
+        }
+
+        // The stride-aware functions work on the image inside the buffer.
+        assert(tga_get_pixel_with_stride(image_data, destination.stride, info,
+                                         width - 1, height - 1) ==
+               image_data + destination.stride * (height - 1) +
+                   (size_t)(width - 1) * pixel_size);
+        tga_image_flip_h_with_stride(image_data, destination.stride, info);
+        tga_image_flip_v_with_stride(image_data, destination.stride, info);
+        tga_image_flip_h(data, info);
+        tga_image_flip_v(data, info);
+        for (int y = 0; y < height; y++) {
+            assert(memcmp(image_data + destination.stride * y,
+                          data + row_size * y, row_size) == 0);
+        }
+        assert(destination.data[destination.stride * 2] == fill_value);
+        assert(destination.data[destination.stride * (height + 2)] ==
+               fill_value);
+
+        // The image does not fit.
+        destination.x = 6;
+        error_code = tga_load_into(&destination, NULL, image_name_list[i],
+                                   NULL);
+        assert(error_code == TGA_ERROR_INVALID_IMAGE_DIMENSIONS);
+        free(file_data);
+        free(destination.data);
+        tga_free_data(data);
+        tga_free_info(info);
+    }
+}
+
+static void convert_test(void) {
+    const char *image_name_list[] = {
+        "images/CBW8.TGA", "images/CCM8.TGA",  "images/CTC16.TGA",
+        "images/CTC24.TGA", "images/CTC32.TGA", "images/UBW8.TGA",
+        "images/UCM8.TGA",  "images/UTC16.TGA", "images/UTC24.TGA",
+        "images/UTC32.TGA"};
+    int image_count = sizeof(image_name_list) / sizeof(image_name_list[0]);
+    const enum tga_pixel_format format_list[] = {
+        TGA_PIXEL_BW8,    TGA_PIXEL_BW16,   TGA_PIXEL_RGB555, TGA_PIXEL_RGB24,
+        TGA_PIXEL_ARGB32, TGA_PIXEL_ABGR32, TGA_PIXEL_ARGB64};
+    int format_count = sizeof(format_list) / sizeof(format_list[0]);
+
+    for (int i = 0; i < image_count; i++) {
+        uint8_t *data;
+        tga_info *info;
+        enum tga_error error_code = tga_load(&data, &info, image_name_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+        int width = tga_get_image_width(info);
+        int height = tga_get_image_height(info);
+        enum tga_pixel_format format = tga_get_pixel_format(info);
+
+        for (int f = 0; f < format_count; f++) {
+            uint8_t *converted;
+            tga_info *converted_info;
+            error_code = tga_convert(&converted, &converted_info, data, info,
+                                     format_list[f]);
+            assert(error_code == TGA_NO_ERROR);
+            assert(tga_get_image_width(converted_info) == width);
+            assert(tga_get_image_height(converted_info) == height);
+            assert(tga_get_pixel_format(converted_info) == format_list[f]);
+            size_t size = (size_t)width * height *
+                          tga_get_bytes_per_pixel(converted_info);
+
+            // Converting to the same format copies the pixels, and the
+            // conversions of 8-bit channels to a format with all of them are
+            // lossless. The attribute bit of RGB555 is not kept.
+            bool has_8_bit_channels = format == TGA_PIXEL_BW8 ||
+                                      format == TGA_PIXEL_RGB24 ||
+                                      format == TGA_PIXEL_ARGB32;
+            bool is_lossless =
+                format_list[f] == format ||
+                (has_8_bit_channels && (format_list[f] == TGA_PIXEL_ARGB32 ||
+                                        format_list[f] == TGA_PIXEL_ABGR32 ||
+                                        format_list[f] == TGA_PIXEL_ARGB64)) ||
+                (format == TGA_PIXEL_BW8 && format_list[f] != TGA_PIXEL_RGB555);
+            if (is_lossless) {
+                uint8_t *restored;
+                tga_info *restored_info;
+                error_code = tga_convert(&restored, &restored_info, converted,
+                                         converted_info, format);
+                assert(error_code == TGA_NO_ERROR);
+                assert(memcmp(restored, data,
+                              (size_t)width * height *
+                                  tga_get_bytes_per_pixel(info)) == 0);
+                tga_free_image(restored, restored_info);
+            }
+
+            // Loading with the conversion gives the same pixels.
+            for (int n = 0; n < 2; n++) {
+                struct tga_load_options options = {0};
+                options.flags = TGA_LOAD_CONVERT;
+                options.pixel_format = format_list[f];
+                options.thread_count = n == 0 ? 0 : 4;
+                uint8_t *loaded;
+                tga_info *loaded_info;
+                error_code = tga_load_with_options(
+                    &loaded, &loaded_info, image_name_list[i], &options);
+                assert(error_code == TGA_NO_ERROR);
+                assert(tga_get_pixel_format(loaded_info) == format_list[f]);
+                assert(memcmp(loaded, converted, size) == 0);
+                tga_free_data(loaded);
+                tga_free_info(loaded_info);
+            }
+
+            // So does the reader, whose scanlines are in the order of the
+            // file.
+            struct tga_load_options options = {0};
+            options.flags = TGA_LOAD_CONVERT;
+            options.pixel_format = format_list[f];
+            tga_reader *reader;
+            error_code = tga_reader_open(&reader, image_name_list[i], &options);
+            assert(error_code == TGA_NO_ERROR);
+            assert(tga_get_pixel_format(tga_reader_get_info(reader)) ==
+                   format_list[f]);
+            size_t row_size = size / height;
+            uint8_t *row = (uint8_t *)malloc(row_size);
+            assert(row != NULL);
+            for (int y = 0; y < height; y++) {
+                error_code = tga_read_scanlines(reader, row, 1);
+                assert(error_code == TGA_NO_ERROR);
+                int image_row =
+                    tga_reader_is_bottom_up(reader) ? height - 1 - y : y;
+                assert(memcmp(row, converted + row_size * image_row,
+                              row_size) == 0);
+            }
+            free(row);
+            tga_reader_close(reader);
+
+            tga_free_image(converted, converted_info);
+        }
+        tga_free_data(data);
+        tga_free_info(info);
+    }
+
+    // The red and blue channels are swapped, the width is not a multiple of
+    // the vector size.
+    const int width = 37;
+    uint8_t *data, *converted;
+    tga_info *info, *converted_info;
+    enum tga_error error_code =
+        tga_create(&data, &info, width, 1, TGA_PIXEL_ARGB32);
+    assert(error_code == TGA_NO_ERROR);
+    for (int i = 0; i < width * 4; i++) {
+        data[i] = (uint8_t)(i * 7 + 1);
+    }
+    error_code =
+        tga_convert(&converted, &converted_info, data, info, TGA_PIXEL_ABGR32);
+    assert(error_code == TGA_NO_ERROR);
+    for (int x = 0; x < width; x++) {
+        const uint8_t *bgra = data + x * 4;
+        const uint8_t *rgba = converted + x * 4;
+        assert(rgba[0] == bgra[2] && rgba[1] == bgra[1] &&
+               rgba[2] == bgra[0] && rgba[3] == bgra[3]);
+    }
+    tga_free_image(converted, converted_info);
+    tga_free_data(data);
+    tga_free_info(info);
+
+    // The 5-bit channels are expanded to the full range.
+    error_code = tga_create(&data, &info, 2, 1, TGA_PIXEL_RGB555);
+    assert(error_code == TGA_NO_ERROR);
+    const uint8_t rgb555[] = {0xFF, 0x7F, 0x1F, 0x00};
+    memcpy(data, rgb555, 4);
+    error_code =
+        tga_convert(&converted, &converted_info, data, info, TGA_PIXEL_ARGB32);
+    assert(error_code == TGA_NO_ERROR);
+    const uint8_t expanded[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0xFF};
+    assert(memcmp(converted, expanded, 8) == 0);
+    tga_free_image(converted, converted_info);
+
+    // The indices cannot be a target.
+    error_code =
+        tga_convert(&converted, &converted_info, data, info, TGA_PIXEL_INDEX8);
+    assert(error_code == TGA_ERROR_UNSUPPORTED_PIXEL_FORMAT);
+    tga_free_data(data);
+    tga_free_info(info);
+
+    // The indices are expanded through the color map.
+    struct tga_load_options options = {0};
+    options.flags = TGA_LOAD_KEEP_COLOR_MAP;
+    error_code =
+        tga_load_with_options(&data, &info, "images/CCM8.TGA", &options);
+    assert(error_code == TGA_NO_ERROR);
+    error_code =
+        tga_convert(&converted, &converted_info, data, info, TGA_PIXEL_RGB555);
+    assert(error_code == TGA_NO_ERROR);
+    uint8_t *expected;
+    tga_info *expected_info;
+    error_code = tga_load(&expected, &expected_info, "images/CCM8.TGA");
+    assert(error_code == TGA_NO_ERROR);
+    assert(memcmp(converted, expected,
+                  (size_t)tga_get_image_width(info) *
+                      tga_get_image_height(info) * 2) == 0);
+    tga_free_data(expected);
+    tga_free_info(expected_info);
+    tga_free_image(converted, converted_info);
+    tga_free_data(data);
+    tga_free_info(info);
+}
+
+// Loads the image converted to the format, with the transform flags.
+static uint8_t *load_transformed(const char *file_name,
+                                 enum tga_pixel_format format,
+                                 unsigned int flags, int thread_count) {
+    struct tga_load_options options = {0};
+    options.flags = TGA_LOAD_CONVERT | flags;
+    options.pixel_format = format;
+    options.thread_count = thread_count;
+    uint8_t *data;
+    tga_info *info;
+    enum tga_error error_code =
+        tga_load_with_options(&data, &info, file_name, &options);
+    assert(error_code == TGA_NO_ERROR);
+    assert(tga_get_pixel_format(info) == format);
+    tga_free_info(info);
+    return data;
+}
+
+static uint16_t get_uint16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static void transform_test(void) {
+    const char *image_name_list[] = {"images/UTC32.TGA", "images/CTC32.TGA",
+                                     "images/UTC24.TGA", "images/CBW8.TGA"};
+    int image_count = sizeof(image_name_list) / sizeof(image_name_list[0]);
+
+    for (int i = 0; i < image_count; i++) {
+        uint8_t *data;
+        tga_info *info;
+        enum tga_error error_code = tga_load(&data, &info, image_name_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+        int pixel_count =
+            tga_get_image_width(info) * tga_get_image_height(info);
+        enum tga_pixel_format format = tga_get_pixel_format(info);
+        tga_free_data(data);
+        tga_free_info(info);
+
+        // The threads give the same result as the calling thread.
+        for (int n = 0; n < 2; n++) {
+            int thread_count = n == 0 ? 0 : 4;
+            uint8_t *pixels = load_transformed(
+                image_name_list[i], TGA_PIXEL_ARGB32, 0, thread_count);
+            uint8_t *premultiplied =
+                load_transformed(image_name_list[i], TGA_PIXEL_ARGB32,
+                                 TGA_LOAD_PREMULTIPLY, thread_count);
+            uint8_t *linear =
+                load_transformed(image_name_list[i], TGA_PIXEL_ARGB32,
+                                 TGA_LOAD_LINEARIZE, thread_count);
+            uint8_t *linear16 =
+                load_transformed(image_name_list[i], TGA_PIXEL_ARGB64,
+                                 TGA_LOAD_LINEARIZE, thread_count);
+            uint8_t *premultiplied16 = load_transformed(
+                image_name_list[i], TGA_PIXEL_ARGB64,
+                TGA_LOAD_LINEARIZE | TGA_LOAD_PREMULTIPLY, thread_count);
+
+            for (int k = 0; k < pixel_count; k++) {
+                const uint8_t *p = pixels + k * 4;
+                uint32_t alpha = p[3];
+                assert(premultiplied[k * 4 + 3] == alpha);
+                assert(linear[k * 4 + 3] == alpha);
+                assert(get_uint16(linear16 + k * 8 + 6) == alpha * 257);
+                for (int c = 0; c < 3; c++) {
+                    // Rounded to nearest.
+                    assert(premultiplied[k * 4 + c] ==
+                           (p[c] * alpha * 2 + 255) / 510);
+                    uint32_t value16 = get_uint16(linear16 + k * 8 + c * 2);
+                    assert(linear[k * 4 + c] ==
+                           (value16 * 255 + 32767) / 65535);
+                    if (p[c] == 0 || p[c] == 255) {
+                        assert(value16 == p[c] * 257u);
+                    }
+                    assert(get_uint16(premultiplied16 + k * 8 + c * 2) ==
+                           ((uint64_t)value16 * alpha * 257 + 32767) / 65535);
+                }
+            }
+            tga_free_data(pixels);
+            tga_free_data(premultiplied);
+            tga_free_data(linear);
+            tga_free_data(linear16);
+            tga_free_data(premultiplied16);
+        }
+
+        // The transforms work on the format of the image without conversion.
+        struct tga_load_options options = {0};
+        options.flags = TGA_LOAD_LINEARIZE | TGA_LOAD_PREMULTIPLY;
+        error_code = tga_load_with_options(&data, &info, image_name_list[i],
+                                           &options);
+        assert(error_code == TGA_NO_ERROR);
+        assert(tga_get_pixel_format(info) == format);
+        tga_free_data(data);
+        tga_free_info(info);
+    }
+
+    // The linear values of the sRGB colors are darker.
+    uint8_t *gray = load_transformed("images/CBW8.TGA", TGA_PIXEL_BW8, 0, 0);
+    uint8_t *linear = load_transformed("images/CBW8.TGA", TGA_PIXEL_BW8,
+                                       TGA_LOAD_LINEARIZE, 0);
+    assert(memcmp(gray, linear, 128) != 0);
+    for (int k = 0; k < 128; k++) {
+        assert(linear[k] <= gray[k]);
+    }
+    tga_free_data(gray);
+    tga_free_data(linear);
+
+    // The 16-bit grayscale and RGB555 cannot hold the linear values.
+    struct tga_load_options options = {0};
+    options.flags = TGA_LOAD_LINEARIZE;
+    uint8_t *data;
+    tga_info *info;
+    enum tga_error error_code =
+        tga_load_with_options(&data, &info, "images/UTC16.TGA", &options);
+    assert(error_code == TGA_ERROR_UNSUPPORTED_PIXEL_FORMAT);
+}
+
+// Checks that the region is the same as the rectangle of the whole image.
+static void check_region(const uint8_t *region_data,
+                         const tga_info *region_info, const uint8_t *data,
+                         const tga_info *info, int x, int y) {
+    int width = tga_get_image_width(region_info);
+    int height = tga_get_image_height(region_info);
+    int pixel_size = tga_get_bytes_per_pixel(info);
+    size_t row_size = (size_t)tga_get_image_width(info) * pixel_size;
+    size_t region_row_size = (size_t)width * pixel_size;
+    for (int row = 0; row < height; row++) {
+        assert(memcmp(region_data + region_row_size * row,
+                      data + row_size * (y + row) + (size_t)x * pixel_size,
+                      region_row_size) == 0);
+    }
+}
+
+static void region_test(void) {
+    // The image descriptor is the last byte of the header.
+    const int descriptor_offset = 17;
+    const char *image_name_list[] = {
+        "images/CBW8.TGA", "images/CCM8.TGA",  "images/CTC16.TGA",
+        "images/CTC24.TGA", "images/CTC32.TGA", "images/UBW8.TGA",
+        "images/UCM8.TGA",  "images/UTC16.TGA", "images/UTC24.TGA",
+        "images/UTC32.TGA"};
+    int image_count = sizeof(image_name_list) / sizeof(image_name_list[0]);
+
+    for (int i = 0; i < image_count; i++) {
+        size_t buffer_size;
+        uint8_t *buffer = read_file(image_name_list[i], &buffer_size);
+        assert(buffer != NULL);
+        // Checks the regions with the origin in each corner.
+        uint8_t descriptor = buffer[descriptor_offset];
+        for (int corner = 0; corner < 4; corner++) {
+            buffer[descriptor_offset] = (descriptor & 0xCF) | corner << 4;
+            uint8_t *data;
+            tga_info *info;
+            enum tga_error error_code =
+                tga_load_from_memory(&data, &info, buffer, buffer_size);
+            assert(error_code == TGA_NO_ERROR);
+            int width = tga_get_image_width(info);
+            int height = tga_get_image_height(info);
+            const int region_list[][4] = {{0, 0, width, height},
+                                          {0, 0, 1, 1},
+                                          {width - 1, height - 1, 1, 1},
+                                          {3, 5, width - 10, height - 7},
+                                          {7, 2, 33, 1},
+                                          {width - 1, 0, 1, height},
+                                          {0, 11, width, 13}};
+            int region_count = sizeof(region_list) / sizeof(region_list[0]);
+            for (int r = 0; r < region_count; r++) {
+                const int *region = region_list[r];
+                uint8_t *region_data;
+                tga_info *region_info;
+                error_code = tga_load_region_from_memory(
+                    &region_data, &region_info, buffer, buffer_size, region[0],
+                    region[1], region[2], region[3], NULL);
+                assert(error_code == TGA_NO_ERROR);
+                assert(tga_get_image_width(region_info) == region[2]);
+                assert(tga_get_image_height(region_info) == region[3]);
+                assert(tga_get_pixel_format(region_info) ==
+                       tga_get_pixel_format(info));
+                check_region(region_data, region_info, data, info, region[0],
+                             region[1]);
+                tga_free_data(region_data);
+                tga_free_info(region_info);
+            }
+            tga_free_data(data);
+            tga_free_info(info);
+        }
+        buffer[descriptor_offset] = descriptor;
+
+        // Loads from the file, with the options.
+        uint8_t *data;
+        tga_info *info;
+        struct tga_load_options options = {0};
+        options.flags = TGA_LOAD_CONVERT;
+        options.pixel_format = TGA_PIXEL_ABGR32;
+        enum tga_error error_code = tga_load_with_options(
+            &data, &info, image_name_list[i], &options);
+        assert(error_code == TGA_NO_ERROR);
+        uint8_t *region_data;
+        tga_info *region_info;
+        error_code = tga_load_region(&region_data, &region_info,
+                                     image_name_list[i], 17, 9, 40, 30,
+                                     &options);
+        assert(error_code == TGA_NO_ERROR);
+        check_region(region_data, region_info, data, info, 17, 9);
+        tga_free_data(region_data);
+        tga_free_info(region_info);
+
+        // The region must be inside the image.
+        int width = tga_get_image_width(info);
+        int height = tga_get_image_height(info);
+        const int invalid_list[][4] = {{-1, 0, 1, 1},
+                                       {0, -1, 1, 1},
+                                       {0, 0, 0, 1},
+                                       {0, 0, 1, 0},
+                                       {1, 0, width, 1},
+                                       {0, 1, 1, height},
+                                       {width, 0, 1, 1}};
+        int invalid_count = sizeof(invalid_list) / sizeof(invalid_list[0]);
+        for (int r = 0; r < invalid_count; r++) {
+            const int *region = invalid_list[r];
+            error_code = tga_load_region(&region_data, &region_info,
+                                         image_name_list[i], region[0],
+                                         region[1], region[2], region[3],
+                                         NULL);
+            assert(error_code == TGA_ERROR_INVALID_IMAGE_DIMENSIONS);
+        }
+        tga_free_data(data);
+        tga_free_info(info);
+
+        // The data after the last scanline of the region is not needed.
+        if (!(buffer[2] & 0x08) && !(descriptor & 0x20)) {
+            // Bottom-up, so the top row is at the end of the data. Removes
+            // it and the data after it.
+            size_t map_size = buffer[1] ? (size_t)(buffer[5] | buffer[6] << 8) *
+                                              ((buffer[7] + 7) / 8)
+                                        : 0;
+            size_t row_size = (size_t)width * ((buffer[16] + 7) / 8);
+            size_t truncated_size = 18 + buffer[0] + map_size +
+                                    row_size * (height - 1);
+            error_code = tga_load_region_from_memory(
+                &region_data, &region_info, buffer, truncated_size, 0,
+                height - 1, width, 1, NULL);
+            assert(error_code == TGA_NO_ERROR);
+            tga_free_data(region_data);
+            tga_free_info(region_info);
+            error_code = tga_load_region_from_memory(
+                &region_data, &region_info, buffer, truncated_size, 0, 0,
+                width, 1, NULL);
+            assert(error_code == TGA_ERROR_FILE_CANNOT_READ);
+        }
+        free(buffer);
+    }
+}
+
+// Gets the channel of the pixel averaged by the box filter.
+static uint32_t get_channel(const uint8_t *pixel, enum tga_pixel_format format,
+                            int channel) {
+    if (format == TGA_PIXEL_RGB555) {
+        uint32_t value = pixel[0] | pixel[1] << 8;
+        return channel == 3 ? value >> 15 : (value >> (channel * 5)) & 0x1F;
+    }
+    return pixel[channel];
+}
+
+// Checks that each pixel of the reduced image is the average of its box of
+// pixels in the rectangle of the source image.
+static void check_reduced(const uint8_t *reduced, const tga_info *reduced_info,
+                          const uint8_t *data, const tga_info *info, int x,
+                          int y, int width, int height, int box_size) {
+    enum tga_pixel_format format = tga_get_pixel_format(info);
+    int pixel_size = tga_get_bytes_per_pixel(info);
+    int channel_count = format == TGA_PIXEL_RGB555 ? 4 : pixel_size;
+    int reduced_width = tga_get_image_width(reduced_info);
+    int reduced_height = tga_get_image_height(reduced_info);
+    assert(reduced_width == (width + box_size - 1) / box_size);
+    assert(reduced_height == (height + box_size - 1) / box_size);
+    assert(tga_get_pixel_format(reduced_info) == format);
+    size_t row_size = (size_t)tga_get_image_width(info) * pixel_size;
+    for (int ry = 0; ry < reduced_height; ry++) {
+        for (int rx = 0; rx < reduced_width; rx++) {
+            const uint8_t *pixel =
+                reduced + ((size_t)ry * reduced_width + rx) * pixel_size;
+            for (int c = 0; c < channel_count; c++) {
+                uint32_t sum = 0;
+                uint32_t count = 0;
+                for (int by = ry * box_size;
+                     by < (ry + 1) * box_size && by < height; by++) {
+                    for (int bx = rx * box_size;
+                         bx < (rx + 1) * box_size && bx < width; bx++) {
+                        sum += get_channel(data + row_size * (y + by) +
+                                               (size_t)(x + bx) * pixel_size,
+                                           format, c);
+                        count++;
+                    }
+                }
+                assert(get_channel(pixel, format, c) ==
+                       (sum + count / 2) / count);
+            }
+        }
+    }
+}
+
+static void scale_test(void) {
+    const char *image_name_list[] = {
+        "images/CBW8.TGA", "images/CCM8.TGA",  "images/CTC16.TGA",
+        "images/CTC24.TGA", "images/CTC32.TGA", "images/UBW8.TGA",
+        "images/UCM8.TGA",  "images/UTC16.TGA", "images/UTC24.TGA",
+        "images/UTC32.TGA"};
+    int image_count = sizeof(image_name_list) / sizeof(image_name_list[0]);
+
+    for (int i = 0; i < image_count; i++) {
+        uint8_t *data;
+        tga_info *info;
+        enum tga_error error_code = tga_load(&data, &info, image_name_list[i]);
+        assert(error_code == TGA_NO_ERROR);
+        int width = tga_get_image_width(info);
+        int height = tga_get_image_height(info);
+
+        for (int box_size = 2; box_size <= 8; box_size *= 2) {
+            struct tga_load_options options = {0};
+            options.scale_denominator = box_size;
+            uint8_t *reduced;
+            tga_info *reduced_info;
+            error_code = tga_load_with_options(&reduced, &reduced_info,
+                                               image_name_list[i], &options);
+            assert(error_code == TGA_NO_ERROR);
+            check_reduced(reduced, reduced_info, data, info, 0, 0, width,
+                          height, box_size);
+            tga_free_data(reduced);
+            tga_free_info(reduced_info);
+
+            // The boxes on the edges of a region are smaller.
+            error_code = tga_load_region(&reduced, &reduced_info,
+                                         image_name_list[i], 3, 5, 61, 37,
+                                         &options);
+            assert(error_code == TGA_NO_ERROR);
+            check_reduced(reduced, reduced_info, data, info, 3, 5, 61, 37,
+                          box_size);
+            tga_free_data(reduced);
+            tga_free_info(reduced_info);
+        }
+
+        // Each level of the mip chain is half of the previous one.
+        struct tga_mip_level levels[TGA_MAX_MIP_LEVEL_COUNT];
+        int level_count;
+        error_code = tga_load_mip_chain(levels, TGA_MAX_MIP_LEVEL_COUNT,
+                                        &level_count, image_name_list[i], NULL);
+        assert(error_code == TGA_NO_ERROR);
+        assert(tga_get_image_width(levels[level_count - 1].info) == 1);
+        assert(tga_get_image_height(levels[level_count - 1].info) == 1);
+        size_t data_size =
+            (size_t)width * height * tga_get_bytes_per_pixel(info);
+        assert(memcmp(levels[0].data, data, data_size) == 0);
+        for (int k = 1; k < level_count; k++) {
+            const tga_info *previous = levels[k - 1].info;
+            check_reduced(levels[k].data, levels[k].info, levels[k - 1].data,
+                          previous, 0, 0, tga_get_image_width(previous),
+                          tga_get_image_height(previous), 2);
+        }
+
+        // The chain can start from a reduced image and have fewer levels.
+        size_t buffer_size;
+        uint8_t *buffer = read_file(image_name_list[i], &buffer_size);
+        struct tga_load_options options = {0};
+        options.scale_denominator = 4;
+        struct tga_mip_level reduced_levels[3];
+        int reduced_level_count;
+        error_code = tga_load_mip_chain_from_memory(reduced_levels, 3,
+                                                    &reduced_level_count,
+                                                    buffer, buffer_size,
+                                                    &options);
+        assert(error_code == TGA_NO_ERROR);
+        assert(reduced_level_count == 3);
+        check_reduced(reduced_levels[0].data, reduced_levels[0].info, data,
+                      info, 0, 0, width, height, 4);
+        for (int k = 0; k < 3; k++) {
+            assert(tga_get_image_width(reduced_levels[k].info) ==
+                   tga_get_image_width(levels[k + 2].info));
+            if (k > 0) {
+                const tga_info *previous = reduced_levels[k - 1].info;
+                check_reduced(reduced_levels[k].data, reduced_levels[k].info,
+                              reduced_levels[k - 1].data, previous, 0, 0,
+                              tga_get_image_width(previous),
+                              tga_get_image_height(previous), 2);
+            }
+        }
+        for (int k = 0; k < 3; k++) {
+            tga_free_image(reduced_levels[k].data, reduced_levels[k].info);
+        }
+        free(buffer);
+
+        for (int k = 0; k < level_count; k++) {
+            tga_free_image(levels[k].data, levels[k].info);
+        }
+        tga_free_data(data);
+        tga_free_info(info);
+    }
+
+    // The boxes on the edges of an odd sized image are smaller.
+    const char save_name[] = "scale_test.tga";
+    uint8_t *data;
+    tga_info *info;
+    enum tga_error error_code =
+        tga_create(&data, &info, 37, 23, TGA_PIXEL_ARGB32);
+    assert(error_code == TGA_NO_ERROR);
+    for (int k = 0; k < 37 * 23 * 4; k++) {
+        data[k] = (uint8_t)(k * 131 + (k >> 3));
+    }
+    remove(save_name);
+    error_code = tga_save_from_info(data, info, save_name);
+    assert(error_code == TGA_NO_ERROR);
+    struct tga_mip_level levels[TGA_MAX_MIP_LEVEL_COUNT];
+    int level_count;
+    error_code = tga_load_mip_chain(levels, TGA_MAX_MIP_LEVEL_COUNT,
+                                    &level_count, save_name, NULL);
+    assert(error_code == TGA_NO_ERROR);
+    assert(level_count == 7);
+    assert(memcmp(levels[0].data, data, 37 * 23 * 4) == 0);
+    for (int k = 1; k < level_count; k++) {
+        const tga_info *previous = levels[k - 1].info;
+        check_reduced(levels[k].data, levels[k].info, levels[k - 1].data,
+                      previous, 0, 0, tga_get_image_width(previous),
+                      tga_get_image_height(previous), 2);
+    }
+    for (int k = 0; k < level_count; k++) {
+        tga_free_image(levels[k].data, levels[k].info);
+    }
+    remove(save_name);
+    tga_free_data(data);
+    tga_free_info(info);
+
+    // Only 2, 4 and 8 are supported, and the indices cannot be averaged.
+    struct tga_load_options options = {0};
+    options.scale_denominator = 3;
+    error_code =
+        tga_load_with_options(&data, &info, "images/UTC24.TGA", &options);
+    assert(error_code == TGA_ERROR_INVALID_IMAGE_DIMENSIONS);
+    options.scale_denominator = 2;
+    options.flags = TGA_LOAD_KEEP_COLOR_MAP;
+    error_code =
+        tga_load_with_options(&data, &info, "images/UCM8.TGA", &options);
+    assert(error_code == TGA_ERROR_UNSUPPORTED_PIXEL_FORMAT);
+}
+
+static void rotate_test(void) {
+    const enum tga_pixel_format format_list[] = {
+        TGA_PIXEL_BW8,    TGA_PIXEL_BW16,   TGA_PIXEL_RGB555, TGA_PIXEL_RGB24,
+        TGA_PIXEL_ARGB32, TGA_PIXEL_ARGB64, TGA_PIXEL_INDEX8};
+    int format_count = sizeof(format_list) / sizeof(format_list[0]);
+    // Not multiples of the tile size, and more than a band per thread.
+    const int width = 131;
+    const int height = 77;
+
+    for (int f = 0; f < format_count; f++) {
+        uint8_t *data;
+        tga_info *info;
+        enum tga_error error_code =
+            tga_create(&data, &info, width, height, format_list[f]);
+        assert(error_code == TGA_NO_ERROR);
+        int pixel_size = tga_get_bytes_per_pixel(info);
+        for (int k = 0; k < width * height * pixel_size; k++) {
+            data[k] = (uint8_t)(k * 7 + k / 251);
+        }
+
+        // A huge thread count is clamped.
+        const int thread_count_list[] = {0, 4, INT_MAX};
+        for (int n = 0; n < 3; n++) {
+            int thread_count = thread_count_list[n];
+            uint8_t *rotated[4];
+            tga_info *rotated_info[4];
+            error_code = tga_image_rotate_90(&rotated[0], &rotated_info[0],
+                                             data, info, thread_count);
+            assert(error_code == TGA_NO_ERROR);
+            error_code = tga_image_rotate_180(&rotated[1], &rotated_info[1],
+                                              data, info, thread_count);
+            assert(error_code == TGA_NO_ERROR);
+            error_code = tga_image_rotate_270(&rotated[2], &rotated_info[2],
+                                              data, info, thread_count);
+            assert(error_code == TGA_NO_ERROR);
+            error_code = tga_image_transpose(&rotated[3], &rotated_info[3],
+                                             data, info, thread_count);
+            assert(error_code == TGA_NO_ERROR);
+            assert(tga_get_image_width(rotated_info[0]) == height);
+            assert(tga_get_image_height(rotated_info[0]) == width);
+            assert(tga_get_image_width(rotated_info[1]) == width);
+            assert(tga_get_image_height(rotated_info[1]) == height);
+            assert(tga_get_image_width(rotated_info[3]) == height);
+
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    uint8_t *pixel = tga_get_pixel(data, info, x, y);
+                    assert(memcmp(pixel,
+                                  tga_get_pixel(rotated[0], rotated_info[0],
+                                                height - 1 - y, x),
+                                  pixel_size) == 0);
+                    assert(memcmp(pixel,
+                                  tga_get_pixel(rotated[1], rotated_info[1],
+                                                width - 1 - x, height - 1 - y),
+                                  pixel_size) == 0);
+                    assert(memcmp(pixel,
+                                  tga_get_pixel(rotated[2], rotated_info[2], y,
+                                                width - 1 - x),
+                                  pixel_size) == 0);
+                    assert(memcmp(pixel,
+                                  tga_get_pixel(rotated[3], rotated_info[3], y,
+                                                x),
+                                  pixel_size) == 0);
+                }
+            }
+            for (int r = 0; r < 4; r++) {
+                assert(tga_get_pixel_format(rotated_info[r]) ==
+                       format_list[f]);
+                tga_free_image(rotated[r], rotated_info[r]);
+            }
+        }
+
+        uint8_t *cropped;
+        tga_info *cropped_info;
+        error_code =
+            tga_image_crop(&cropped, &cropped_info, data, info, 5, 9, 40, 33);
+        assert(error_code == TGA_NO_ERROR);
+        assert(tga_get_image_width(cropped_info) == 40);
+        assert(tga_get_image_height(cropped_info) == 33);
+        for (int y = 0; y < 33; y++) {
+            assert(memcmp(tga_get_pixel(cropped, cropped_info, 0, y),
+                          tga_get_pixel(data, info, 5, 9 + y),
+                          (size_t)40 * pixel_size) == 0);
+        }
+        tga_free_image(cropped, cropped_info);
+        error_code = tga_image_crop(&cropped, &cropped_info, data, info, 5, 9,
+                                    width - 4, 1);
+        assert(error_code == TGA_ERROR_INVALID_IMAGE_DIMENSIONS);
+        error_code =
+            tga_image_crop(&cropped, &cropped_info, data, info, 0, 0, 0, 1);
+        assert(error_code == TGA_ERROR_INVALID_IMAGE_DIMENSIONS);
+        tga_free_data(data);
+        tga_free_info(info);
+    }
+
+    // The color map is copied.
+    struct tga_load_options options = {0};
+    options.flags = TGA_LOAD_KEEP_COLOR_MAP;
+    uint8_t *data;
+    tga_info *info;
+    enum tga_error error_code =
+        tga_load_with_options(&data, &info, "images/UCM8.TGA", &options);
+    assert(error_code == TGA_NO_ERROR);
+    uint8_t *rotated;
+    tga_info *rotated_info;
+    error_code = tga_image_rotate_90(&rotated, &rotated_info, data, info, 0);
+    assert(error_code == TGA_NO_ERROR);
+    assert(tga_get_color_map(rotated_info) != tga_get_color_map(info));
+    assert(tga_get_color_map_length(rotated_info) ==
+           tga_get_color_map_length(info));
+    assert(memcmp(tga_get_color_map(rotated_info), tga_get_color_map(info),
+                  (size_t)tga_get_color_map_length(info) *
+                      tga_get_color_map_entry_size(info)) == 0);
+    tga_free_image(rotated, rotated_info);
+    tga_free_data(data);
+    tga_free_info(info);
+}
+
+static void view_test(void) {
+    const enum tga_pixel_format format_list[] = {
+        TGA_PIXEL_BW8,    TGA_PIXEL_BW16,   TGA_PIXEL_RGB555, TGA_PIXEL_RGB24,
+        TGA_PIXEL_ARGB32, TGA_PIXEL_ARGB64, TGA_PIXEL_INDEX8};
+    int format_count = sizeof(format_list) / sizeof(format_list[0]);
+    const int width = 13;
+    const int height = 9;
+
+    for (int f = 0; f < format_count; f++) {
+        uint8_t *data;
+        tga_info *info;
+        enum tga_error error_code =
+            tga_create(&data, &info, width, height, format_list[f]);
+        assert(error_code == TGA_NO_ERROR);
+
+        struct tga_image_view view;
+        tga_get_image_view(&view, data, info);
+        assert(view.data == data);
+        assert(view.width == width);
+        assert(view.height == height);
+        assert(view.bytes_per_pixel == tga_get_bytes_per_pixel(info));
+        assert(view.stride == (size_t)width * view.bytes_per_pixel);
+        assert(view.pixel_format == format_list[f]);
+        for (int y = 0; y < height; y++) {
+            assert(tga_view_get_row(&view, y) ==
+                   tga_get_pixel(data, info, 0, y));
+            for (int x = 0; x < width; x++) {
+                assert(tga_get_pixel_unchecked(&view, x, y) ==
+                       tga_get_pixel(data, info, x, y));
+            }
+        }
+
+        // A view of the image with padded rows.
+        size_t stride = view.stride + 5;
+        tga_get_image_view_with_stride(&view, data, stride, info);
+        assert(view.stride == stride);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                assert(tga_get_pixel_unchecked(&view, x, y) ==
+                       tga_get_pixel_with_stride(data, stride, info, x, y));
+            }
+        }
+        tga_free_image(data, info);
+    }
+}
+
+#ifdef TGAFUNC_TEST_THREADS
+
+#define THREAD_COUNT 8
+#define THREAD_ITERATION_COUNT 10
+
+static const char *thread_image_name_list[] = {
+    "images/CBW8.TGA", "images/CCM8.TGA",  "images/CTC16.TGA",
+    "images/CTC24.TGA", "images/CTC32.TGA", "images/UBW8.TGA",
+    "images/UCM8.TGA",  "images/UTC16.TGA", "images/UTC24.TGA",
+    "images/UTC32.TGA", "images/NOT_EXIST.TGA"};
+#define THREAD_IMAGE_COUNT \
+    (sizeof(thread_image_name_list) / sizeof(thread_image_name_list[0]))
+
+struct thread_test_context {
+    uint8_t *data[THREAD_IMAGE_COUNT];
+    tga_info *info[THREAD_IMAGE_COUNT];
+    enum tga_error error_code[THREAD_IMAGE_COUNT];
+    // The file data of the images, for loading from memory.
+    uint8_t *buffer[THREAD_IMAGE_COUNT];
+    size_t buffer_size[THREAD_IMAGE_COUNT];
+    // Only accessed by the worker thread which owns the slot.
+    int failure_count[THREAD_COUNT];
+};
+
+struct thread_test_arg {
+    struct thread_test_context *context;
+    int thread_index;
+};
+
+// Loads all images repeatedly and compares them with the images loaded by the
+// main thread.
+static void *thread_test_worker(void *arg) {
+    struct thread_test_arg *test_arg = (struct thread_test_arg *)arg;
+    struct thread_test_context *context = test_arg->context;
+    int failure_count = 0;
+    for (int n = 0; n < THREAD_ITERATION_COUNT; n++) {
+        for (size_t i = 0; i < THREAD_IMAGE_COUNT; i++) {
+            // Starts from a different image in each thread.
+            size_t k = (i + test_arg->thread_index) % THREAD_IMAGE_COUNT;
+            uint8_t *data;
+            tga_info *info;
+            enum tga_error error_code;
+            if (context->buffer[k] != NULL && n % 2) {
+                error_code = tga_load_from_memory(&data, &info,
+                                                  context->buffer[k],
+                                                  context->buffer_size[k]);
+            } else {
+                error_code =
+                    tga_load(&data, &info, thread_image_name_list[k]);
+            }
+            if (error_code != context->error_code[k]) {
+                failure_count++;
+                continue;
+            }
+            if (error_code != TGA_NO_ERROR) {
+                continue;
+            }
+            size_t data_size = (size_t)tga_get_image_width(info) *
+                               tga_get_image_height(info) *
+                               tga_get_bytes_per_pixel(info);
+            if (memcmp(data, context->data[k], data_size) != 0) {
+                failure_count++;
+            }
+            tga_free_data(data);
+            tga_free_info(info);
+        }
+    }
+    context->failure_count[test_arg->thread_index] = failure_count;
+    return NULL;
+}
+
+static void thread_test(void) {
+    struct thread_test_context context;
+    memset(&context, 0, sizeof(context));
+    for (size_t i = 0; i < THREAD_IMAGE_COUNT; i++) {
+        context.error_code[i] = tga_load(&context.data[i], &context.info[i],
+                                         thread_image_name_list[i]);
+        if (context.error_code[i] == TGA_NO_ERROR) {
+            context.buffer[i] =
+                read_file(thread_image_name_list[i], &context.buffer_size[i]);
+        }
+    }
+
+    pthread_t threads[THREAD_COUNT];
+    struct thread_test_arg args[THREAD_COUNT];
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        args[i].context = &context;
+        args[i].thread_index = i;
+        int result =
+            pthread_create(&threads[i], NULL, thread_test_worker, &args[i]);
+        assert(result == 0);
+    }
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        pthread_join(threads[i], NULL);
+        assert(context.failure_count[i] == 0);
+    }
+
+    for (size_t i = 0; i < THREAD_IMAGE_COUNT; i++) {
+        if (context.error_code[i] == TGA_NO_ERROR) {
+            tga_free_data(context.data[i]);
+            tga_free_info(context.info[i]);
+            free(context.buffer[i]);
+        }
+    }
+}
+
+#endif  // TGAFUNC_TEST_THREADS
+
 int main(int argc, char *argv[]) {
     create_test();
     load_test();
+    load_from_memory_test();
+    map_test();
+    flip_test();
+    orientation_test();
+    color_map_index_test();
+    keep_color_map_test();
+    save_rle_test();
+    reader_test();
+    writer_test();
+    parallel_load_test();
+    batch_test();
+    loader_test();
+    probe_test();
+    allocator_test();
+    load_into_test();
+    convert_test();
+    transform_test();
+    region_test();
+    scale_test();
+    rotate_test();
+    view_test();
+#ifdef TGAFUNC_TEST_THREADS
+    thread_test();
+#endif
     puts("Test cases passed.");
     return 0;
 }
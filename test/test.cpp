@@ -0,0 +1,185 @@
+// Copyright (c) 2021 Caden Ji
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include "tgafunc.hpp"
+
+static const char *image_name_list[] = {
+    "images/CBW8.TGA",  "images/CCM8.TGA",  "images/CTC16.TGA",
+    "images/CTC24.TGA", "images/CTC32.TGA", "images/UBW8.TGA",
+    "images/UCM8.TGA",  "images/UTC16.TGA", "images/UTC24.TGA",
+    "images/UTC32.TGA"};
+static const int image_count =
+    sizeof(image_name_list) / sizeof(image_name_list[0]);
+
+static const tga::Format format_list[] = {
+    tga::Format::BW8,    tga::Format::BW16,   tga::Format::RGB555,
+    tga::Format::RGB24,  tga::Format::ARGB32, tga::Format::ABGR32,
+    tga::Format::ARGB64};
+static const int format_count = sizeof(format_list) / sizeof(format_list[0]);
+
+static_assert(tga::kPixelSize<tga::Format::RGB24> == 3);
+static_assert(tga::kPixelSize<tga::Format::ARGB64> == 8);
+static_assert(!std::is_copy_constructible_v<tga::Image>);
+static_assert(std::is_nothrow_move_constructible_v<tga::Image>);
+static_assert(tga::convert_pixel<tga::Bw8>(tga::Argb32{0, 0xFF, 0, 0xFF})
+                  .value == 150);
+
+static void image_test() {
+    tga::Image image;
+    assert(image.empty());
+    assert(image.create(5, 3, tga::Format::RGB24) == TGA_NO_ERROR);
+    assert(image && image.width() == 5 && image.height() == 3);
+    assert(image.format() == tga::Format::RGB24);
+    assert(image.stride() == 15);
+
+    const uint8_t *data = image.data();
+    tga::Image moved(std::move(image));
+    assert(image.empty());
+    assert(moved.data() == data);
+    image = std::move(moved);
+    assert(moved.empty());
+    assert(image.data() == data);
+
+    // Errors leave the image unchanged.
+    assert(image.create(0, 3, tga::Format::BW8) ==
+           TGA_ERROR_INVALID_IMAGE_DIMENSIONS);
+    assert(image.data() == data);
+    assert(image.load("images/NOT_EXIST.TGA") != TGA_NO_ERROR);
+    assert(image.data() == data);
+
+    uint8_t *released_data;
+    tga_info *released_info;
+    image.release(&released_data, &released_info);
+    assert(image.empty() && released_data == data);
+    tga_free_image(released_data, released_info);
+}
+
+static void view_test() {
+    for (int i = 0; i < image_count; i++) {
+        tga::Image image;
+        assert(image.load(image_name_list[i]) == TGA_NO_ERROR);
+        uint8_t *data = image.data();
+        const tga_info *info = image.info();
+        tga::visit(image, [&](auto view) {
+            using Pixel = std::remove_pointer_t<decltype(view.row(0))>;
+            assert(static_cast<int>(sizeof(Pixel)) == image.bytes_per_pixel());
+            for (int y = 0; y < view.height(); y++) {
+                for (int x = 0; x < view.width(); x++) {
+                    assert(reinterpret_cast<uint8_t *>(&view(x, y)) ==
+                           tga_get_pixel(data, info, x, y));
+                }
+            }
+        });
+
+        // A view of the C image view.
+        tga_image_view c_view;
+        tga_get_image_view(&c_view, data, info);
+        if (image.format() == tga::Format::BW8) {
+            tga::ConstImageView<tga::Format::BW8> view(c_view);
+            assert(&view(1, 2).value == tga_get_pixel_unchecked(&c_view, 1, 2));
+        }
+    }
+}
+
+static void flip_test() {
+    for (int i = 0; i < image_count; i++) {
+        tga::Image image;
+        assert(image.load(image_name_list[i]) == TGA_NO_ERROR);
+        tga::Image expected;
+        assert(expected.load(image_name_list[i]) == TGA_NO_ERROR);
+        size_t data_size = image.stride() * image.height();
+
+        tga::visit(image, [](auto view) { tga::flip_h(view); });
+        tga_image_flip_h(expected.data(), expected.info());
+        assert(memcmp(image.data(), expected.data(), data_size) == 0);
+        tga::visit(image, [](auto view) { tga::flip_v(view); });
+        tga_image_flip_v(expected.data(), expected.info());
+        assert(memcmp(image.data(), expected.data(), data_size) == 0);
+
+        tga::Image copied;
+        assert(copied.create(image.width(), image.height(),
+                             image.format()) == TGA_NO_ERROR);
+        tga::visit(copied, [&](auto dest) {
+            using View = decltype(dest);
+            tga::copy(dest, View(image.data(), image.stride(), image.width(),
+                                 image.height()));
+        });
+        assert(memcmp(copied.data(), expected.data(), data_size) == 0);
+    }
+}
+
+// The templated conversions give the same pixels as tga_convert().
+static void convert_test() {
+    const int width = 37;
+    const int height = 5;
+    for (int i = 0; i < format_count; i++) {
+        tga::Image source;
+        assert(source.create(width, height, format_list[i]) == TGA_NO_ERROR);
+        size_t data_size = source.stride() * height;
+        for (size_t k = 0; k < data_size; k++) {
+            source.data()[k] = static_cast<uint8_t>(k * 37 + k / 7);
+        }
+        const tga::Image &const_source = source;
+
+        for (int j = 0; j < format_count; j++) {
+            tga::Image expected;
+            assert(source.convert(expected, format_list[j]) == TGA_NO_ERROR);
+            tga::Image converted;
+            assert(converted.create(width, height, format_list[j]) ==
+                   TGA_NO_ERROR);
+            tga::visit(converted, [&](auto dest) {
+                tga::visit(source, [&](auto src) {
+                    using Dest = std::remove_pointer_t<decltype(dest.row(0))>;
+                    using Source = std::remove_pointer_t<decltype(src.row(0))>;
+                    if constexpr (!std::is_same_v<Dest, tga::Index8> &&
+                                  !std::is_same_v<Source, tga::Index8>) {
+                        tga::convert(dest, src);
+                    }
+                });
+            });
+            assert(memcmp(converted.data(), expected.data(),
+                          converted.stride() * height) == 0);
+        }
+
+        if (format_list[i] == tga::Format::ARGB32) {
+            auto view = const_source.view<tga::Format::ARGB32>();
+            tga::Abgr32 pixel = tga::convert_pixel<tga::Abgr32>(view(3, 1));
+            assert(pixel.r == view(3, 1).r && pixel.b == view(3, 1).b);
+        }
+    }
+}
+
+int main() {
+    image_test();
+    view_test();
+    flip_test();
+    convert_test();
+    puts("C++ test cases passed.");
+    return 0;
+}
@@ -20,6 +20,11 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+// Exposes posix_memalign() and madvise() when compiling in strict C99 mode.
+#if !defined(_DEFAULT_SOURCE) && (defined(__unix__) || defined(__APPLE__))
+#define _DEFAULT_SOURCE
+#endif
+
 #include "tgafunc.h"
 
 #include <stdbool.h>
@@ -28,95 +33,431 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HAS_MMAP
+#endif
+
+#if !defined(TGAFUNC_NO_THREADS) && (defined(__unix__) || defined(__APPLE__))
+#include <pthread.h>
+#define HAS_THREADS
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HAS_SSE2
+#endif
+
 struct tga_info {
     uint16_t width, height;
     enum tga_pixel_format pixel_format;
+    // The color map of a TGA_PIXEL_INDEX8 format image, otherwise null.
+    uint8_t *color_map;
+    uint16_t map_first_index;
+    uint16_t map_length;
+    uint8_t map_entry_size;
+    // Allocates the info structure, the color map and the image data. All
+    // fields null means malloc() and free().
+    struct tga_allocator allocator;
 };
 
+// Allocates memory with the allocator, or with malloc() if the allocator is
+// null or has no functions.
+static inline void *allocate(const struct tga_allocator *allocator,
+                             size_t size) {
+    if (allocator == NULL || allocator->alloc == NULL) {
+        return malloc(size);
+    }
+    return allocator->alloc(allocator->user_data, size);
+}
+
+// Releases memory allocated by allocate() with the same allocator.
+static inline void deallocate(const struct tga_allocator *allocator,
+                              void *ptr) {
+    if (allocator == NULL || allocator->alloc == NULL) {
+        free(ptr);
+    } else if (allocator->release != NULL) {
+        allocator->release(allocator->user_data, ptr);
+    }
+}
+
 static inline bool check_dimensions(int width, int height);
 
 static inline int pixel_format_to_pixel_size(enum tga_pixel_format format);
 
+static tga_info *create_info(int width, int height,
+                             enum tga_pixel_format format,
+                             const struct tga_allocator *allocator);
+
+static enum tga_error create_image(uint8_t **data_out, tga_info **info_out,
+                                   int width, int height,
+                                   enum tga_pixel_format format,
+                                   const struct tga_allocator *allocator,
+                                   bool is_zeroed);
+
+static void convert_pixels(uint8_t *dest, enum tga_pixel_format dest_format,
+                           const uint8_t *src, enum tga_pixel_format src_format,
+                           int count);
+
+// Byte size of the TGA file header.
+#define HEADER_SIZE 18
+
+// Size of the buffer used to read data from the file stream in blocks.
+#define SOURCE_BUFFER_SIZE 16384
+
+// The decoder reads the TGA data through this structure, so that the same code
+// can handle both file streams and memory buffers.
+struct data_source {
+    // Not null when reading from a file stream.
+    FILE *file;
+    // The bytes that can be read without touching the file stream. Points to
+    // the whole data when reading from a memory buffer, otherwise points to
+    // the file_buffer.
+    const uint8_t *buffer;
+    size_t size;
+    size_t position;
+    // Set by read_uint8() and read_uint16_le() when the read fails, so that a
+    // sequence of reads can be checked once.
+    bool has_read_error;
+    uint8_t file_buffer[SOURCE_BUFFER_SIZE];
+};
+
+static inline void init_file_source(struct data_source *source, FILE *file);
+
+static inline void init_memory_source(struct data_source *source,
+                                      const void *buffer, size_t size);
+
+// A rectangle of the image, with the origin in the upper left corner.
+struct image_region {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
 static enum tga_error load_image(uint8_t **data_out, tga_info **info_out,
-                                 FILE *file);
+                                 const struct tga_destination *destination,
+                                 const struct image_region *region,
+                                 struct data_source *source,
+                                 const struct tga_load_options *options);
+
+static enum tga_error load_file(uint8_t **data_out, tga_info **info_out,
+                                const struct tga_destination *destination,
+                                const struct image_region *region,
+                                const char *file_name,
+                                const struct tga_load_options *options);
+
+static enum tga_error load_mip_chain(struct tga_mip_level *levels,
+                                     int max_level_count,
+                                     int *level_count_out,
+                                     struct data_source *source,
+                                     const struct tga_load_options *options);
+
+static void release_or_return_info(tga_info *info, tga_info **info_out);
+
+static inline uint8_t *get_pixel(uint8_t *data, size_t stride,
+                                 const tga_info *info, int x, int y);
+
+static void reverse_row(uint8_t *row, int width, int pixel_size);
+
+static void swap_rows(uint8_t *row1, uint8_t *row2, size_t row_size);
+
+struct tga_mapped_image {
+    tga_info info;
+    // Points to the top row of the image.
+    const uint8_t *data;
+    // Byte distance from one row to the next row below it, negative when the
+    // rows are stored from bottom to top.
+    int stride;
+    // The mapped file, null if the mapping is not available.
+    void *mapping;
+    size_t mapping_size;
+    // Not null if the image could not be used in place and has been decoded.
+    uint8_t *decoded_data;
+    tga_info *decoded_info;
+};
 
-static inline uint8_t *get_pixel(uint8_t *data, const tga_info *info, int x,
-                                 int y);
+static enum tga_error map_image(tga_mapped_image *image, const char *file_name);
 
-static enum tga_error save_image(const uint8_t *data, const tga_info *info,
-                                 FILE *file);
+#ifdef HAS_MMAP
+static bool map_file(const char *file_name, void **mapping_out,
+                     size_t *size_out);
+#endif
+
+static int clamp_thread_count(int thread_count);
+
+static void run_parallel(void (*task)(void *arg, int index), void *arg,
+                         int task_count, int thread_count);
+
+static void load_batch_item(void *arg, int index);
+
+static enum tga_error probe_image(struct tga_header_info *header_out,
+                                  struct data_source *source);
 
 enum tga_error tga_create(uint8_t **data_out, tga_info **info_out, int width,
                           int height, enum tga_pixel_format format) {
-    if (check_dimensions(width, height)) {
-        return TGA_ERROR_INVALID_IMAGE_DIMENSIONS;
+    return tga_create_with_allocator(data_out, info_out, width, height, format,
+                                     NULL);
+}
+
+enum tga_error tga_create_with_allocator(
+    uint8_t **data_out, tga_info **info_out, int width, int height,
+    enum tga_pixel_format format, const struct tga_allocator *allocator) {
+    return create_image(data_out, info_out, width, height, format, allocator,
+                        true);
+}
+
+enum tga_error tga_create_uninitialized(uint8_t **data_out, tga_info **info_out,
+                                        int width, int height,
+                                        enum tga_pixel_format format) {
+    return create_image(data_out, info_out, width, height, format, NULL,
+                        false);
+}
+
+enum tga_error tga_load(uint8_t **data_out, tga_info **info_out,
+                        const char *file_name) {
+    return tga_load_with_options(data_out, info_out, file_name, NULL);
+}
+
+enum tga_error tga_load_with_options(uint8_t **data_out, tga_info **info_out,
+                                     const char *file_name,
+                                     const struct tga_load_options *options) {
+    return load_file(data_out, info_out, NULL, NULL, file_name, options);
+}
+
+enum tga_error tga_load_into(const struct tga_destination *destination,
+                             tga_info **info_out, const char *file_name,
+                             const struct tga_load_options *options) {
+    if (destination == NULL) {
+        return TGA_ERROR_NO_DATA;
     }
-    int pixel_size = pixel_format_to_pixel_size(format);
-    if (pixel_size == -1) {
-        return TGA_ERROR_UNSUPPORTED_PIXEL_FORMAT;
+    tga_info *info;
+    enum tga_error error_code =
+        load_file(NULL, &info, destination, NULL, file_name, options);
+    if (error_code == TGA_NO_ERROR) {
+        release_or_return_info(info, info_out);
     }
+    return error_code;
+}
 
-    // Creates image data and info structure.
-    uint8_t *data = (uint8_t *)calloc((size_t)width * height, pixel_size);
-    if (data == NULL) {
-        return TGA_ERROR_OUT_OF_MEMORY;
+enum tga_error tga_load_from_memory(uint8_t **data_out, tga_info **info_out,
+                                    const void *buffer, size_t size) {
+    return tga_load_from_memory_with_options(data_out, info_out, buffer, size,
+                                             NULL);
+}
+
+enum tga_error tga_load_from_memory_with_options(
+    uint8_t **data_out, tga_info **info_out, const void *buffer, size_t size,
+    const struct tga_load_options *options) {
+    if (buffer == NULL || size == 0) {
+        return TGA_ERROR_NO_DATA;
     }
-    tga_info *info = (tga_info *)malloc(sizeof(tga_info));
-    if (info == NULL) {
-        free(data);
-        return TGA_ERROR_OUT_OF_MEMORY;
+    struct data_source source;
+    init_memory_source(&source, buffer, size);
+    return load_image(data_out, info_out, NULL, NULL, &source, options);
+}
+
+enum tga_error tga_load_from_memory_into(
+    const struct tga_destination *destination, tga_info **info_out,
+    const void *buffer, size_t size, const struct tga_load_options *options) {
+    if (destination == NULL || buffer == NULL || size == 0) {
+        return TGA_ERROR_NO_DATA;
     }
-    info->width = width;
-    info->height = height;
-    info->pixel_format = format;
+    struct data_source source;
+    init_memory_source(&source, buffer, size);
+    tga_info *info;
+    enum tga_error error_code =
+        load_image(NULL, &info, destination, NULL, &source, options);
+    if (error_code == TGA_NO_ERROR) {
+        release_or_return_info(info, info_out);
+    }
+    return error_code;
+}
 
-    *data_out = data;
-    *info_out = info;
-    return TGA_NO_ERROR;
+enum tga_error tga_load_region(uint8_t **data_out, tga_info **info_out,
+                               const char *file_name, int x, int y, int width,
+                               int height,
+                               const struct tga_load_options *options) {
+    struct image_region region = {x, y, width, height};
+    return load_file(data_out, info_out, NULL, &region, file_name, options);
 }
 
-enum tga_error tga_load(uint8_t **data_out, tga_info **info_out,
-                        const char *file_name) {
+enum tga_error tga_load_region_from_memory(
+    uint8_t **data_out, tga_info **info_out, const void *buffer, size_t size,
+    int x, int y, int width, int height,
+    const struct tga_load_options *options) {
+    if (buffer == NULL || size == 0) {
+        return TGA_ERROR_NO_DATA;
+    }
+    struct data_source source;
+    init_memory_source(&source, buffer, size);
+    struct image_region region = {x, y, width, height};
+    return load_image(data_out, info_out, NULL, &region, &source, options);
+}
+
+enum tga_error tga_load_mip_chain(struct tga_mip_level *levels,
+                                  int max_level_count, int *level_count_out,
+                                  const char *file_name,
+                                  const struct tga_load_options *options) {
     FILE *file = fopen(file_name, "rb");
     if (file == NULL) {
         return TGA_ERROR_FILE_CANNOT_READ;
     }
-    enum tga_error error_code = load_image(data_out, info_out, file);
+    struct data_source source;
+    init_file_source(&source, file);
+    enum tga_error error_code = load_mip_chain(levels, max_level_count,
+                                               level_count_out, &source,
+                                               options);
     fclose(file);
     return error_code;
 }
 
+enum tga_error tga_load_mip_chain_from_memory(
+    struct tga_mip_level *levels, int max_level_count, int *level_count_out,
+    const void *buffer, size_t size, const struct tga_load_options *options) {
+    if (buffer == NULL || size == 0) {
+        return TGA_ERROR_NO_DATA;
+    }
+    struct data_source source;
+    init_memory_source(&source, buffer, size);
+    return load_mip_chain(levels, max_level_count, level_count_out, &source,
+                          options);
+}
+
+enum tga_error tga_probe(struct tga_header_info *header_out,
+                         const char *file_name) {
+    FILE *file = fopen(file_name, "rb");
+    if (file == NULL) {
+        return TGA_ERROR_FILE_CANNOT_READ;
+    }
+    // Reads only the header and the ID field, which are at most 273 bytes,
+    // instead of a whole block of the file.
+    uint8_t buffer[HEADER_SIZE + 255];
+    setvbuf(file, NULL, _IONBF, 0);
+    size_t size = fread(buffer, 1, HEADER_SIZE, file);
+    if (size == HEADER_SIZE) {
+        size += fread(buffer + HEADER_SIZE, 1, buffer[0], file);
+    }
+    fclose(file);
+    struct data_source source;
+    init_memory_source(&source, buffer, size);
+    return probe_image(header_out, &source);
+}
+
+enum tga_error tga_probe_memory(struct tga_header_info *header_out,
+                                const void *buffer, size_t size) {
+    if (buffer == NULL || size == 0) {
+        return TGA_ERROR_NO_DATA;
+    }
+    struct data_source source;
+    init_memory_source(&source, buffer, size);
+    return probe_image(header_out, &source);
+}
+
+// The arguments of load_batch_item().
+struct batch_job {
+    struct tga_batch_item *items;
+    const struct tga_batch_options *options;
+};
+
+enum tga_error tga_load_batch(struct tga_batch_item *items, int item_count,
+                              const struct tga_batch_options *options) {
+    if (items == NULL || item_count <= 0) {
+        return TGA_ERROR_NO_DATA;
+    }
+    struct tga_batch_options default_options = {0};
+    if (options == NULL) {
+        options = &default_options;
+    }
+    struct batch_job job = {items, options};
+    run_parallel(load_batch_item, &job, item_count, options->thread_count);
+    for (int i = 0; i < item_count; ++i) {
+        if (items[i].error_code != TGA_NO_ERROR) {
+            return items[i].error_code;
+        }
+    }
+    return TGA_NO_ERROR;
+}
+
+enum tga_error tga_map(tga_mapped_image **image_out, const char *file_name) {
+    tga_mapped_image *image =
+        (tga_mapped_image *)calloc(1, sizeof(tga_mapped_image));
+    if (image == NULL) {
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    enum tga_error error_code = map_image(image, file_name);
+    if (error_code != TGA_NO_ERROR) {
+        tga_unmap(image);
+        return error_code;
+    }
+    *image_out = image;
+    return TGA_NO_ERROR;
+}
+
+const uint8_t *tga_mapped_get_data(const tga_mapped_image *image) {
+    return image->data;
+}
+
+int tga_mapped_get_stride(const tga_mapped_image *image) {
+    return image->stride;
+}
+
+const tga_info *tga_mapped_get_info(const tga_mapped_image *image) {
+    return &image->info;
+}
+
+int tga_mapped_is_zero_copy(const tga_mapped_image *image) {
+    return image->decoded_data == NULL;
+}
+
+void tga_unmap(tga_mapped_image *image) {
+    if (image == NULL) {
+        return;
+    }
+#ifdef HAS_MMAP
+    if (image->mapping != NULL) {
+        munmap(image->mapping, image->mapping_size);
+    }
+#endif
+    tga_free_data(image->decoded_data);
+    tga_free_info(image->decoded_info);
+    free(image);
+}
+
 enum tga_error tga_save(const uint8_t *data, int width, int height,
                         enum tga_pixel_format format, const char *file_name) {
     if (check_dimensions(width, height)) {
         return TGA_ERROR_INVALID_IMAGE_DIMENSIONS;
     }
-    tga_info info = {width, height, format};
+    tga_info info = {width, height, format, NULL, 0, 0, 0, {NULL, NULL, NULL}};
     return tga_save_from_info(data, &info, file_name);
 }
 
 enum tga_error tga_save_from_info(const uint8_t *data, const tga_info *info,
                                   const char *file_name) {
+    return tga_save_with_options(data, info, file_name, NULL);
+}
+
+enum tga_error tga_save_with_options(const uint8_t *data, const tga_info *info,
+                                     const char *file_name,
+                                     const struct tga_save_options *options) {
     if (data == NULL || info == NULL) {
         return TGA_ERROR_NO_DATA;
     }
-    // Check if a file with the same name already exists.
-    FILE *file = fopen(file_name, "r");
-    if (file != NULL) {
-        fclose(file);
-        return TGA_ERROR_FILE_CANNOT_WRITE;
-    }
-    file = fopen(file_name, "wb");
-    if (file == NULL) {
-        return TGA_ERROR_FILE_CANNOT_WRITE;
-    }
-
-    enum tga_error error_code = save_image(data, info, file);
-    fclose(file);
+    tga_writer *writer;
+    enum tga_error error_code =
+        tga_writer_open_from_info(&writer, info, file_name, options);
     if (error_code != TGA_NO_ERROR) {
-        remove(file_name);
+        return error_code;
     }
-    return error_code;
+    error_code = tga_write_scanlines(writer, data, info->height);
+    // Closing the writer also removes the file if the image is incomplete.
+    enum tga_error close_error_code = tga_writer_close(writer);
+    return error_code != TGA_NO_ERROR ? error_code : close_error_code;
 }
 
 int tga_get_image_width(const tga_info *info) { return info->width; }
@@ -131,30 +472,86 @@ uint8_t tga_get_bytes_per_pixel(const tga_info *info) {
     return pixel_format_to_pixel_size(info->pixel_format);
 }
 
+const uint8_t *tga_get_color_map(const tga_info *info) {
+    return info->color_map;
+}
+
+int tga_get_color_map_first_index(const tga_info *info) {
+    return info->map_first_index;
+}
+
+int tga_get_color_map_length(const tga_info *info) { return info->map_length; }
+
+uint8_t tga_get_color_map_entry_size(const tga_info *info) {
+    return info->map_entry_size;
+}
+
 uint8_t *tga_get_pixel(uint8_t *data, const tga_info *info, int x, int y) {
-    return get_pixel(data, info, x, y);
+    size_t row_size =
+        (size_t)info->width * pixel_format_to_pixel_size(info->pixel_format);
+    return get_pixel(data, row_size, info, x, y);
+}
+
+uint8_t *tga_get_pixel_with_stride(uint8_t *data, size_t stride,
+                                   const tga_info *info, int x, int y) {
+    return get_pixel(data, stride, info, x, y);
+}
+
+void tga_get_image_view(struct tga_image_view *view, uint8_t *data,
+                        const tga_info *info) {
+    size_t row_size =
+        (size_t)info->width * pixel_format_to_pixel_size(info->pixel_format);
+    tga_get_image_view_with_stride(view, data, row_size, info);
+}
+
+void tga_get_image_view_with_stride(struct tga_image_view *view, uint8_t *data,
+                                    size_t stride, const tga_info *info) {
+    view->data = data;
+    view->stride = stride;
+    view->bytes_per_pixel = pixel_format_to_pixel_size(info->pixel_format);
+    view->width = info->width;
+    view->height = info->height;
+    view->pixel_format = info->pixel_format;
 }
 
 void tga_free_data(void *data) { free(data); }
 
-void tga_free_info(tga_info *info) { free(info); }
+void tga_free_info(tga_info *info) {
+    if (info == NULL) {
+        return;
+    }
+    // The info structure is released by its own allocator.
+    struct tga_allocator allocator = info->allocator;
+    deallocate(&allocator, info->color_map);
+    deallocate(&allocator, info);
+}
+
+void tga_free_image(uint8_t *data, tga_info *info) {
+    if (info == NULL) {
+        free(data);
+        return;
+    }
+    deallocate(&info->allocator, data);
+    tga_free_info(info);
+}
 
 void tga_image_flip_h(uint8_t *data, const tga_info *info) {
     if (data == NULL || info == NULL) {
         return;
     }
+    size_t row_size =
+        (size_t)info->width * pixel_format_to_pixel_size(info->pixel_format);
+    tga_image_flip_h_with_stride(data, row_size, info);
+}
+
+void tga_image_flip_h_with_stride(uint8_t *data, size_t stride,
+                                  const tga_info *info) {
+    if (data == NULL || info == NULL) {
+        return;
+    }
     int pixel_size = pixel_format_to_pixel_size(info->pixel_format);
-    uint8_t temp[pixel_size];
-    int flip_num = info->width / 2;
-    for (int i = 0; i < flip_num; ++i) {
-        for (int j = 0; j < info->height; ++j) {
-            uint8_t *p1 = get_pixel(data, info, i, j);
-            uint8_t *p2 = get_pixel(data, info, info->width - 1 - i, j);
-            // Swap two pixels.
-            memcpy(temp, p1, pixel_size);
-            memcpy(p1, p2, pixel_size);
-            memcpy(p2, temp, pixel_size);
-        }
+    for (int i = 0; i < info->height; ++i) {
+        reverse_row(data + stride * i, info->width, pixel_size);
     }
 }
 
@@ -162,60 +559,396 @@ void tga_image_flip_v(uint8_t *data, const tga_info *info) {
     if (data == NULL || info == NULL) {
         return;
     }
+    size_t row_size =
+        (size_t)info->width * pixel_format_to_pixel_size(info->pixel_format);
+    tga_image_flip_v_with_stride(data, row_size, info);
+}
+
+void tga_image_flip_v_with_stride(uint8_t *data, size_t stride,
+                                  const tga_info *info) {
+    if (data == NULL || info == NULL) {
+        return;
+    }
     int pixel_size = pixel_format_to_pixel_size(info->pixel_format);
-    uint8_t temp[pixel_size];
+    size_t row_size = (size_t)info->width * pixel_size;
     int flip_num = info->height / 2;
     for (int i = 0; i < flip_num; ++i) {
-        for (int j = 0; j < info->width; ++j) {
-            uint8_t *p1 = get_pixel(data, info, j, i);
-            uint8_t *p2 = get_pixel(data, info, j, info->height - 1 - i);
-            // Swap two pixels.
-            memcpy(temp, p1, pixel_size);
-            memcpy(p1, p2, pixel_size);
-            memcpy(p2, temp, pixel_size);
+        uint8_t *row1 = data + stride * i;
+        uint8_t *row2 = data + stride * (info->height - 1 - i);
+        swap_rows(row1, row2, row_size);
+    }
+}
+
+// Gets the pixel format of the color map entries.
+// Returns false means no error, otherwise returns true (unsupported entry
+// size).
+static bool get_color_map_format(enum tga_pixel_format *format,
+                                 const tga_info *info) {
+    switch (info->map_entry_size) {
+        case 2:
+            *format = TGA_PIXEL_RGB555;
+            return false;
+        case 3:
+            *format = TGA_PIXEL_RGB24;
+            return false;
+        case 4:
+            *format = TGA_PIXEL_ARGB32;
+            return false;
+        default:
+            return true;
+    }
+}
+
+// Expands a row of indices to the color map entries.
+// Returns false means no error, otherwise returns true (index out of range).
+static bool expand_index_row(uint8_t *dest, const uint8_t *indices,
+                             const tga_info *info) {
+    int entry_size = info->map_entry_size;
+    for (int i = 0; i < info->width; ++i) {
+        int index = indices[i] - info->map_first_index;
+        if (index < 0 || index >= info->map_length) {
+            return true;
         }
+        memcpy(dest + i * entry_size, info->color_map + index * entry_size,
+               entry_size);
     }
+    return false;
 }
 
-enum tga_image_type {
-    TGA_TYPE_NO_DATA = 0,
-    TGA_TYPE_COLOR_MAPPED = 1,
-    TGA_TYPE_TRUE_COLOR = 2,
-    TGA_TYPE_GRAYSCALE = 3,
-    TGA_TYPE_RLE_COLOR_MAPPED = 9,
-    TGA_TYPE_RLE_TRUE_COLOR = 10,
-    TGA_TYPE_RLE_GRAYSCALE = 11
-};
+enum tga_error tga_convert(uint8_t **data_out, tga_info **info_out,
+                           const uint8_t *data, const tga_info *info,
+                           enum tga_pixel_format format) {
+    if (data == NULL || info == NULL) {
+        return TGA_ERROR_NO_DATA;
+    }
+    if (format == TGA_PIXEL_INDEX8 ||
+        pixel_format_to_pixel_size(format) == -1) {
+        return TGA_ERROR_UNSUPPORTED_PIXEL_FORMAT;
+    }
+    enum tga_pixel_format src_format = info->pixel_format;
+    uint8_t *entries = NULL;
+    if (src_format == TGA_PIXEL_INDEX8) {
+        if (info->color_map == NULL ||
+            get_color_map_format(&src_format, info)) {
+            return TGA_ERROR_UNSUPPORTED_PIXEL_FORMAT;
+        }
+        entries = (uint8_t *)malloc((size_t)info->width * info->map_entry_size);
+        if (entries == NULL) {
+            return TGA_ERROR_OUT_OF_MEMORY;
+        }
+    }
 
-struct tga_header {
-    uint8_t id_length;
-    uint8_t map_type;
-    uint8_t image_type;
+    uint8_t *new_data;
+    tga_info *new_info;
+    enum tga_error error_code =
+        create_image(&new_data, &new_info, info->width, info->height, format,
+                     &info->allocator, false);
+    if (error_code != TGA_NO_ERROR) {
+        free(entries);
+        return error_code;
+    }
+    size_t src_row_size =
+        (size_t)info->width * pixel_format_to_pixel_size(info->pixel_format);
+    size_t dest_row_size =
+        (size_t)info->width * pixel_format_to_pixel_size(format);
+    for (int y = 0; y < info->height; ++y) {
+        const uint8_t *src_row = data + src_row_size * y;
+        if (entries != NULL) {
+            if (expand_index_row(entries, src_row, info)) {
+                error_code = TGA_ERROR_COLOR_MAP_INDEX_FAILED;
+                break;
+            }
+            src_row = entries;
+        }
+        convert_pixels(new_data + dest_row_size * y, format, src_row,
+                       src_format, info->width);
+    }
+    free(entries);
+    if (error_code != TGA_NO_ERROR) {
+        tga_free_image(new_data, new_info);
+        return error_code;
+    }
+    *data_out = new_data;
+    *info_out = new_info;
+    return TGA_NO_ERROR;
+}
 
-    // Color map specification.
-    uint16_t map_first_entry;
-    uint16_t map_length;
-    uint8_t map_entry_size;
+// Creates an image of the size with the pixel format, the allocator and the
+// color map of the info. The pixels are not initialized.
+static enum tga_error create_image_like(uint8_t **data_out, tga_info **info_out,
+                                        int width, int height,
+                                        const tga_info *info) {
+    uint8_t *data;
+    tga_info *new_info;
+    enum tga_error error_code =
+        create_image(&data, &new_info, width, height, info->pixel_format,
+                     &info->allocator, false);
+    if (error_code != TGA_NO_ERROR) {
+        return error_code;
+    }
+    if (info->color_map != NULL) {
+        size_t map_size = (size_t)info->map_length * info->map_entry_size;
+        new_info->color_map = (uint8_t *)allocate(&info->allocator, map_size);
+        if (new_info->color_map == NULL) {
+            tga_free_image(data, new_info);
+            return TGA_ERROR_OUT_OF_MEMORY;
+        }
+        memcpy(new_info->color_map, info->color_map, map_size);
+        new_info->map_first_index = info->map_first_index;
+        new_info->map_length = info->map_length;
+        new_info->map_entry_size = info->map_entry_size;
+    }
+    *data_out = data;
+    *info_out = new_info;
+    return TGA_NO_ERROR;
+}
 
-    // Image specification.
-    uint16_t image_x_origin;
-    uint16_t image_y_origin;
-    uint16_t image_width;
-    uint16_t image_height;
-    uint8_t pixel_depth;
-    uint8_t image_descriptor;
-};
+// Width and height in pixels of the tiles of the remapping. The pixels of a
+// tile and the source pixels it reads fit in the L1 cache together.
+#define REMAP_TILE_SIZE 32
 
-struct color_map {
-    uint16_t first_index;
-    uint16_t entry_count;
-    uint8_t bytes_per_entry;
-    uint8_t *pixels;
+// Copies the pixels of the source image to a rotated or transposed image. The
+// pixel (x, y) of the image comes from origin + x * x_step + y * y_step, the
+// steps are in bytes and may be negative.
+struct remapping {
+    uint8_t *data;
+    int width;
+    int height;
+    int pixel_size;
+    const uint8_t *origin;
+    ptrdiff_t x_step;
+    ptrdiff_t y_step;
+    // Number of rows of each band, a multiple of REMAP_TILE_SIZE.
+    int band_rows;
 };
 
-#define HEADER_SIZE 18
-
-#define IS_SUPPORTED_IMAGE_TYPE(header)                  \
+// Remaps the rows from first_row to last_row (exclusive) tile by tile, so
+// that the columns walked in the source stay in the cache. Called with a
+// constant pixel_size, so that the copy of each pixel is specialized.
+static inline void remap_rows(const struct remapping *remapping,
+                              int first_row, int last_row, int pixel_size) {
+    size_t row_size = (size_t)remapping->width * pixel_size;
+    for (int tile_y = first_row; tile_y < last_row;
+         tile_y += REMAP_TILE_SIZE) {
+        int tile_bottom = tile_y + REMAP_TILE_SIZE < last_row
+                              ? tile_y + REMAP_TILE_SIZE
+                              : last_row;
+        for (int tile_x = 0; tile_x < remapping->width;
+             tile_x += REMAP_TILE_SIZE) {
+            int tile_right = tile_x + REMAP_TILE_SIZE < remapping->width
+                                 ? tile_x + REMAP_TILE_SIZE
+                                 : remapping->width;
+            for (int y = tile_y; y < tile_bottom; ++y) {
+                uint8_t *dest = remapping->data + row_size * y +
+                                (size_t)tile_x * pixel_size;
+                const uint8_t *src = remapping->origin +
+                                     tile_x * remapping->x_step +
+                                     y * remapping->y_step;
+                for (int x = tile_x; x < tile_right; ++x) {
+                    memcpy(dest, src, pixel_size);
+                    dest += pixel_size;
+                    src += remapping->x_step;
+                }
+            }
+        }
+    }
+}
+
+// Remaps a band of rows, called by run_parallel().
+static void remap_band(void *arg, int band) {
+    const struct remapping *remapping = (const struct remapping *)arg;
+    int first_row = band * remapping->band_rows;
+    int last_row = first_row + remapping->band_rows;
+    if (last_row > remapping->height) {
+        last_row = remapping->height;
+    }
+    switch (remapping->pixel_size) {
+        case 1:
+            remap_rows(remapping, first_row, last_row, 1);
+            break;
+        case 2:
+            remap_rows(remapping, first_row, last_row, 2);
+            break;
+        case 3:
+            remap_rows(remapping, first_row, last_row, 3);
+            break;
+        case 4:
+            remap_rows(remapping, first_row, last_row, 4);
+            break;
+        case 8:
+            remap_rows(remapping, first_row, last_row, 8);
+            break;
+        default:
+            break;
+    }
+}
+
+// The geometric transforms done by remap_image().
+enum remap_type {
+    REMAP_ROTATE_90,
+    REMAP_ROTATE_180,
+    REMAP_ROTATE_270,
+    REMAP_TRANSPOSE
+};
+
+// Creates the transformed image, the bands of rows are remapped by up to
+// thread_count threads.
+static enum tga_error remap_image(uint8_t **data_out, tga_info **info_out,
+                                  const uint8_t *data, const tga_info *info,
+                                  enum remap_type type, int thread_count) {
+    if (data == NULL || info == NULL) {
+        return TGA_ERROR_NO_DATA;
+    }
+    struct remapping remapping;
+    remapping.pixel_size = pixel_format_to_pixel_size(info->pixel_format);
+    ptrdiff_t stride = (ptrdiff_t)info->width * remapping.pixel_size;
+    const uint8_t *last_row = data + stride * (info->height - 1);
+    bool is_swapped = type != REMAP_ROTATE_180;
+    remapping.width = is_swapped ? info->height : info->width;
+    remapping.height = is_swapped ? info->width : info->height;
+    switch (type) {
+        case REMAP_ROTATE_90:
+            // The rows come from the columns of the source, bottom to top.
+            remapping.origin = last_row;
+            remapping.x_step = -stride;
+            remapping.y_step = remapping.pixel_size;
+            break;
+        case REMAP_ROTATE_180:
+            remapping.origin =
+                last_row + (ptrdiff_t)(info->width - 1) * remapping.pixel_size;
+            remapping.x_step = -remapping.pixel_size;
+            remapping.y_step = -stride;
+            break;
+        case REMAP_ROTATE_270:
+            // The rows come from the columns of the source, right to left.
+            remapping.origin =
+                data + (ptrdiff_t)(info->width - 1) * remapping.pixel_size;
+            remapping.x_step = stride;
+            remapping.y_step = -remapping.pixel_size;
+            break;
+        default:
+            remapping.origin = data;
+            remapping.x_step = stride;
+            remapping.y_step = remapping.pixel_size;
+            break;
+    }
+
+    enum tga_error error_code =
+        create_image_like(&remapping.data, info_out, remapping.width,
+                          remapping.height, info);
+    if (error_code != TGA_NO_ERROR) {
+        return error_code;
+    }
+    // Several bands per thread, so that the threads stay busy.
+    thread_count = clamp_thread_count(thread_count);
+    int band_count = thread_count > 1 ? thread_count * 4 : 1;
+    int band_tiles = (remapping.height + REMAP_TILE_SIZE - 1) / REMAP_TILE_SIZE;
+    band_tiles = (band_tiles + band_count - 1) / band_count;
+    remapping.band_rows = band_tiles * REMAP_TILE_SIZE;
+    band_count =
+        (remapping.height + remapping.band_rows - 1) / remapping.band_rows;
+    run_parallel(remap_band, &remapping, band_count, thread_count);
+    *data_out = remapping.data;
+    return TGA_NO_ERROR;
+}
+
+enum tga_error tga_image_rotate_90(uint8_t **data_out, tga_info **info_out,
+                                   const uint8_t *data, const tga_info *info,
+                                   int thread_count) {
+    return remap_image(data_out, info_out, data, info, REMAP_ROTATE_90,
+                       thread_count);
+}
+
+enum tga_error tga_image_rotate_180(uint8_t **data_out, tga_info **info_out,
+                                    const uint8_t *data, const tga_info *info,
+                                    int thread_count) {
+    return remap_image(data_out, info_out, data, info, REMAP_ROTATE_180,
+                       thread_count);
+}
+
+enum tga_error tga_image_rotate_270(uint8_t **data_out, tga_info **info_out,
+                                    const uint8_t *data, const tga_info *info,
+                                    int thread_count) {
+    return remap_image(data_out, info_out, data, info, REMAP_ROTATE_270,
+                       thread_count);
+}
+
+enum tga_error tga_image_transpose(uint8_t **data_out, tga_info **info_out,
+                                   const uint8_t *data, const tga_info *info,
+                                   int thread_count) {
+    return remap_image(data_out, info_out, data, info, REMAP_TRANSPOSE,
+                       thread_count);
+}
+
+enum tga_error tga_image_crop(uint8_t **data_out, tga_info **info_out,
+                              const uint8_t *data, const tga_info *info, int x,
+                              int y, int width, int height) {
+    if (data == NULL || info == NULL) {
+        return TGA_ERROR_NO_DATA;
+    }
+    if (x < 0 || y < 0 || width <= 0 || height <= 0 ||
+        width > info->width - x || height > info->height - y) {
+        return TGA_ERROR_INVALID_IMAGE_DIMENSIONS;
+    }
+    uint8_t *new_data;
+    enum tga_error error_code =
+        create_image_like(&new_data, info_out, width, height, info);
+    if (error_code != TGA_NO_ERROR) {
+        return error_code;
+    }
+    int pixel_size = pixel_format_to_pixel_size(info->pixel_format);
+    size_t src_row_size = (size_t)info->width * pixel_size;
+    size_t row_size = (size_t)width * pixel_size;
+    const uint8_t *src = data + src_row_size * y + (size_t)x * pixel_size;
+    for (int i = 0; i < height; ++i) {
+        memcpy(new_data + row_size * i, src + src_row_size * i, row_size);
+    }
+    *data_out = new_data;
+    return TGA_NO_ERROR;
+}
+
+enum tga_image_type {
+    TGA_TYPE_NO_DATA = 0,
+    TGA_TYPE_COLOR_MAPPED = 1,
+    TGA_TYPE_TRUE_COLOR = 2,
+    TGA_TYPE_GRAYSCALE = 3,
+    TGA_TYPE_RLE_COLOR_MAPPED = 9,
+    TGA_TYPE_RLE_TRUE_COLOR = 10,
+    TGA_TYPE_RLE_GRAYSCALE = 11
+};
+
+struct tga_header {
+    uint8_t id_length;
+    uint8_t map_type;
+    uint8_t image_type;
+
+    // Color map specification.
+    uint16_t map_first_entry;
+    uint16_t map_length;
+    uint8_t map_entry_size;
+
+    // Image specification.
+    uint16_t image_x_origin;
+    uint16_t image_y_origin;
+    uint16_t image_width;
+    uint16_t image_height;
+    uint8_t pixel_depth;
+    uint8_t image_descriptor;
+};
+
+struct color_map {
+    uint16_t first_index;
+    uint16_t entry_count;
+    uint8_t bytes_per_entry;
+    uint8_t *pixels;
+    // The color of each 8-bit index, padded to 4 bytes so that the pixels can
+    // be copied with fixed size stores.
+    uint8_t lookup_table[256 * 4];
+    // Non-zero if the index is in the color map.
+    uint8_t is_valid_index[256];
+};
+
+#define IS_SUPPORTED_IMAGE_TYPE(header)                  \
     ((header).image_type == TGA_TYPE_COLOR_MAPPED ||     \
      (header).image_type == TGA_TYPE_TRUE_COLOR ||       \
      (header).image_type == TGA_TYPE_GRAYSCALE ||        \
@@ -243,30 +976,195 @@ struct color_map {
 // Convert bits to integer bytes. E.g. 8 bits to 1 byte, 9 bits to 2 bytes.
 #define BITS_TO_BYTES(bit_count) (((bit_count)-1) / 8 + 1)
 
-static bool has_read_file_error = false;
+static inline void init_file_source(struct data_source *source, FILE *file) {
+    source->file = file;
+    source->buffer = source->file_buffer;
+    source->size = 0;
+    source->position = 0;
+    source->has_read_error = false;
+}
+
+static inline void init_memory_source(struct data_source *source,
+                                      const void *buffer, size_t size) {
+    source->file = NULL;
+    source->buffer = (const uint8_t *)buffer;
+    source->size = size;
+    source->position = 0;
+    source->has_read_error = false;
+}
+
+// Reads `size` bytes from the source to `dest`.
+// Returns false means no error, otherwise returns true.
+static inline bool read_bytes(struct data_source *source, void *dest,
+                              size_t size) {
+    size_t available = source->size - source->position;
+    if (size <= available) {
+        memcpy(dest, source->buffer + source->position, size);
+        source->position += size;
+        return false;
+    }
+    if (source->file == NULL) {
+        // Never reads beyond the end of the memory buffer.
+        return true;
+    }
+
+    // Takes the rest of the buffered bytes first.
+    memcpy(dest, source->buffer + source->position, available);
+    dest = (uint8_t *)dest + available;
+    size -= available;
+    source->position = source->size;
+    if (size >= SOURCE_BUFFER_SIZE) {
+        // Large blocks are read directly without going through the buffer.
+        return fread(dest, 1, size, source->file) != size;
+    }
+    source->size = fread(source->file_buffer, 1, SOURCE_BUFFER_SIZE,
+                         source->file);
+    source->position = 0;
+    if (size > source->size) {
+        return true;
+    }
+    memcpy(dest, source->buffer, size);
+    source->position = size;
+    return false;
+}
+
+// Skips `size` bytes of the source.
+// Returns false means no error, otherwise returns true.
+static inline bool skip_bytes(struct data_source *source, size_t size) {
+    size_t available = source->size - source->position;
+    if (size <= available) {
+        source->position += size;
+        return false;
+    }
+    if (source->file == NULL) {
+        return true;
+    }
+    // Drops the buffered bytes and moves the file position.
+    source->position = source->size;
+    return fseek(source->file, (long)(size - available), SEEK_CUR) != 0;
+}
 
-// Reads a 8-bit integer from the file stream.
-static inline uint8_t read_uint8(FILE *file) {
+// Reads a 8-bit integer from the source.
+static inline uint8_t read_uint8(struct data_source *source) {
     uint8_t value;
-    if (fread(&value, 1, 1, file) != 1) {
-        has_read_file_error = true;
+    if (read_bytes(source, &value, 1)) {
+        source->has_read_error = true;
         return 0;
     }
     return value;
 }
 
-// Gets a 16-bit little-endian integer from the file stream.
+// Gets a 16-bit little-endian integer from the source.
 // This function should works on both big-endian and little-endian architecture
 // systems.
-static inline uint16_t read_uint16_le(FILE *file) {
+static inline uint16_t read_uint16_le(struct data_source *source) {
     uint8_t buffer[2];
-    if (fread(&buffer, 1, 2, file) != 2) {
-        has_read_file_error = true;
+    if (read_bytes(source, &buffer, 2)) {
+        source->has_read_error = true;
         return 0;
     }
     return buffer[0] + (((uint16_t)buffer[1]) << 8);
 }
 
+// Creates the info structure of an image without color map.
+// Returns a null pointer if out of memory.
+static tga_info *create_info(int width, int height,
+                             enum tga_pixel_format format,
+                             const struct tga_allocator *allocator) {
+    tga_info *info = (tga_info *)allocate(allocator, sizeof(tga_info));
+    if (info == NULL) {
+        return NULL;
+    }
+    info->width = width;
+    info->height = height;
+    info->pixel_format = format;
+    info->color_map = NULL;
+    info->map_first_index = 0;
+    info->map_length = 0;
+    info->map_entry_size = 0;
+    if (allocator != NULL) {
+        info->allocator = *allocator;
+    } else {
+        memset(&info->allocator, 0, sizeof(info->allocator));
+    }
+    return info;
+}
+
+// The alignment of large image data, which is the usual huge page size.
+#define HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+// The image data of at least this size is aligned to HUGE_PAGE_SIZE, so that
+// the kernel can back it with huge pages. Such large blocks are mapped freshly
+// by malloc() anyway, smaller blocks are usually reused from the heap, and
+// forcing the alignment on them would make every load fault the pages again.
+#define LARGE_DATA_SIZE ((size_t)32 * 1024 * 1024)
+
+// Allocates the image data, set to 0 if is_zeroed is true. Large images
+// allocated by the default allocator are aligned to HUGE_PAGE_SIZE, the memory
+// is still released by free().
+static void *allocate_data(const struct tga_allocator *allocator, size_t size,
+                           bool is_zeroed) {
+    bool is_default = allocator == NULL || allocator->alloc == NULL;
+    void *data;
+#ifdef HAS_MMAP
+    if (is_default && size >= LARGE_DATA_SIZE) {
+        if (posix_memalign(&data, HUGE_PAGE_SIZE, size) != 0) {
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        // Only a hint, the failure is harmless.
+        madvise(data, size, MADV_HUGEPAGE);
+#endif
+        if (is_zeroed) {
+            memset(data, 0, size);
+        }
+        return data;
+    }
+#endif
+    if (is_default && is_zeroed) {
+        // calloc() gets the pages of large blocks already zeroed from the
+        // system, they are not touched until they are used.
+        return calloc(1, size);
+    }
+    data = allocate(allocator, size);
+    if (data != NULL && is_zeroed) {
+        memset(data, 0, size);
+    }
+    return data;
+}
+
+// Creates the image data and the info structure. The pixels are set to 0 if
+// is_zeroed is true, otherwise left uninitialized for the caller to fill.
+static enum tga_error create_image(uint8_t **data_out, tga_info **info_out,
+                                   int width, int height,
+                                   enum tga_pixel_format format,
+                                   const struct tga_allocator *allocator,
+                                   bool is_zeroed) {
+    if (check_dimensions(width, height)) {
+        return TGA_ERROR_INVALID_IMAGE_DIMENSIONS;
+    }
+    int pixel_size = pixel_format_to_pixel_size(format);
+    if (pixel_size == -1) {
+        return TGA_ERROR_UNSUPPORTED_PIXEL_FORMAT;
+    }
+
+    // Creates image data and info structure.
+    size_t data_size = (size_t)width * height * pixel_size;
+    uint8_t *data = (uint8_t *)allocate_data(allocator, data_size, is_zeroed);
+    if (data == NULL) {
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    tga_info *info = create_info(width, height, format, allocator);
+    if (info == NULL) {
+        deallocate(allocator, data);
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+
+    *data_out = data;
+    *info_out = info;
+    return TGA_NO_ERROR;
+}
+
 // Checks if the picture size is correct.
 // Returns true if invalid dimensisns, otherwise returns false.
 static inline bool check_dimensions(int width, int height) {
@@ -280,6 +1178,7 @@ static inline bool check_dimensions(int width, int height) {
 static inline int pixel_format_to_pixel_size(enum tga_pixel_format format) {
     switch (format) {
         case TGA_PIXEL_BW8:
+        case TGA_PIXEL_INDEX8:
             return 1;
         case TGA_PIXEL_BW16:
         case TGA_PIXEL_RGB555:
@@ -287,7 +1186,10 @@ static inline int pixel_format_to_pixel_size(enum tga_pixel_format format) {
         case TGA_PIXEL_RGB24:
             return 3;
         case TGA_PIXEL_ARGB32:
+        case TGA_PIXEL_ABGR32:
             return 4;
+        case TGA_PIXEL_ARGB64:
+            return 8;
         default:
             return -1;
     }
@@ -299,7 +1201,7 @@ static bool get_pixel_format(enum tga_pixel_format *format,
                              const struct tga_header *header) {
     if (IS_COLOR_MAPPED(*header)) {
         // If the supported pixel_depth is changed, remember to also change
-        // the pixel_to_map_index() function.
+        // the init_lookup_table() and expand_indices() functions.
         if (header->pixel_depth == 8) {
             switch (header->map_entry_size) {
                 case 15:
@@ -339,26 +1241,26 @@ static bool get_pixel_format(enum tga_pixel_format *format,
     return true;
 }
 
-// Loads TGA header from file stream and returns the pixel format.
+// Loads TGA header from the source and returns the pixel format.
 static enum tga_error load_header(struct tga_header *header,
                                   enum tga_pixel_format *pixel_format,
-                                  FILE *file) {
-    has_read_file_error = false;
-
-    header->id_length = read_uint8(file);
-    header->map_type = read_uint8(file);
-    header->image_type = read_uint8(file);
-    header->map_first_entry = read_uint16_le(file);
-    header->map_length = read_uint16_le(file);
-    header->map_entry_size = read_uint8(file);
-    header->image_x_origin = read_uint16_le(file);
-    header->image_y_origin = read_uint16_le(file);
-    header->image_width = read_uint16_le(file);
-    header->image_height = read_uint16_le(file);
-    header->pixel_depth = read_uint8(file);
-    header->image_descriptor = read_uint8(file);
-
-    if (has_read_file_error) {
+                                  struct data_source *source) {
+    source->has_read_error = false;
+
+    header->id_length = read_uint8(source);
+    header->map_type = read_uint8(source);
+    header->image_type = read_uint8(source);
+    header->map_first_entry = read_uint16_le(source);
+    header->map_length = read_uint16_le(source);
+    header->map_entry_size = read_uint8(source);
+    header->image_x_origin = read_uint16_le(source);
+    header->image_y_origin = read_uint16_le(source);
+    header->image_width = read_uint16_le(source);
+    header->image_height = read_uint16_le(source);
+    header->pixel_depth = read_uint8(source);
+    header->image_descriptor = read_uint8(source);
+
+    if (source->has_read_error) {
         return TGA_ERROR_FILE_CANNOT_READ;
     }
     if (header->map_type > 1) {
@@ -380,208 +1282,2440 @@ static enum tga_error load_header(struct tga_header *header,
     return TGA_NO_ERROR;
 }
 
-// Used for color mapped image decode.
-static inline uint16_t pixel_to_map_index(uint8_t *pixel_ptr) {
-    // Because only 8-bit index is supported now, so implemented in this way.
-    return pixel_ptr[0];
+// Reads the header and the ID field of the image into the public structure.
+static enum tga_error probe_image(struct tga_header_info *header_out,
+                                  struct data_source *source) {
+    struct tga_header header;
+    enum tga_pixel_format pixel_format;
+    enum tga_error error_code = load_header(&header, &pixel_format, source);
+    if (error_code != TGA_NO_ERROR) {
+        return error_code;
+    }
+    memset(header_out->id, 0, sizeof(header_out->id));
+    if (read_bytes(source, header_out->id, header.id_length)) {
+        return TGA_ERROR_FILE_CANNOT_READ;
+    }
+    header_out->id_length = header.id_length;
+    header_out->width = header.image_width;
+    header_out->height = header.image_height;
+    header_out->pixel_format = pixel_format;
+    header_out->image_type = header.image_type;
+    header_out->pixel_depth = header.pixel_depth;
+    header_out->alpha_bits = header.image_descriptor & 0x0F;
+    header_out->is_rle = IS_RLE(header);
+    header_out->is_color_mapped = IS_COLOR_MAPPED(header);
+    header_out->is_bottom_up = !(header.image_descriptor & 0x20);
+    header_out->is_right_to_left = (header.image_descriptor & 0x10) != 0;
+    header_out->x_origin = header.image_x_origin;
+    header_out->y_origin = header.image_y_origin;
+    header_out->map_first_index = header.map_first_entry;
+    header_out->map_length = header.map_length;
+    header_out->map_entry_size = header.map_entry_size;
+    return TGA_NO_ERROR;
 }
 
-// Gets the color of the specified index from the map.
-// Returns false means no error, otherwise returns true.
-static inline bool try_get_color_from_map(uint8_t *dest, uint16_t index,
-                                          const struct color_map *map) {
-    index -= map->first_index;
-    if (index < 0 && index >= map->entry_count) {
-        return true;
+// Builds the lookup table of the color map. Only 8-bit index is supported, so
+// every possible index has an entry in the table.
+static void init_lookup_table(struct color_map *map) {
+    memset(map->lookup_table, 0, sizeof(map->lookup_table));
+    for (int index = 0; index < 256; ++index) {
+        int entry = index - map->first_index;
+        bool is_valid = entry >= 0 && entry < map->entry_count;
+        map->is_valid_index[index] = is_valid;
+        if (is_valid) {
+            memcpy(map->lookup_table + index * 4,
+                   map->pixels + map->bytes_per_entry * entry,
+                   map->bytes_per_entry);
+        }
     }
-    memcpy(dest, map->pixels + map->bytes_per_entry * index,
-           map->bytes_per_entry);
-    return false;
 }
 
-// Decode image data from file stream.
-static enum tga_error decode_data(uint8_t *data, const tga_info *info,
-                                  uint8_t pixel_size, bool is_color_mapped,
-                                  const struct color_map *map, FILE *file) {
-    enum tga_error error_code = TGA_NO_ERROR;
-    size_t pixel_count = (size_t)info->width * info->height;
+// Expands `count` 8-bit color map indices to pixels at `dest`.
+// Returns false means no error, otherwise returns true (an index is not in the
+// color map).
+static bool expand_indices(uint8_t *dest, const uint8_t *indices, size_t count,
+                           const struct color_map *map) {
+    const uint8_t *table = map->lookup_table;
+    // Checks the indices once for the whole block.
+    uint8_t is_valid = 1;
+    for (size_t i = 0; i < count; ++i) {
+        is_valid &= map->is_valid_index[indices[i]];
+    }
+    if (!is_valid) {
+        return true;
+    }
 
-    if (is_color_mapped) {
-        for (; pixel_count > 0; --pixel_count) {
-            if (fread(data, 1, pixel_size, file) != pixel_size) {
-                error_code = TGA_ERROR_FILE_CANNOT_READ;
-                break;
+    switch (map->bytes_per_entry) {
+        case 2:
+            for (size_t i = 0; i < count; ++i) {
+                memcpy(dest + i * 2, table + indices[i] * 4, 2);
             }
-            // In color mapped image, the pixel as the index value of the color
-            // map. The actual pixel value is found from the color map.
-            uint16_t index = pixel_to_map_index(data);
-            if (try_get_color_from_map(data, index, map)) {
-                error_code = TGA_ERROR_COLOR_MAP_INDEX_FAILED;
+            break;
+        case 3:
+            if (count == 0) {
                 break;
             }
-            data += map->bytes_per_entry;
-        }
-    } else {
-        size_t data_size = pixel_count * pixel_size;
-        if (fread(data, 1, data_size, file) != data_size) {
-            error_code = TGA_ERROR_FILE_CANNOT_READ;
-        }
+            // Each store writes 4 bytes, the extra byte is overwritten by the
+            // next pixel. The last pixel is copied separately.
+            for (size_t i = 0; i < count - 1; ++i) {
+                memcpy(dest + i * 3, table + indices[i] * 4, 4);
+            }
+            memcpy(dest + (count - 1) * 3, table + indices[count - 1] * 4, 3);
+            break;
+        case 4:
+            for (size_t i = 0; i < count; ++i) {
+                memcpy(dest + i * 4, table + indices[i] * 4, 4);
+            }
+            break;
     }
-    return error_code;
+    return false;
 }
 
-// Decode image data with run-length encoding from file stream.
-static enum tga_error decode_data_rle(uint8_t *data, const tga_info *info,
-                                      uint8_t pixel_size, bool is_color_mapped,
-                                      const struct color_map *map, FILE *file) {
-    enum tga_error error_code = TGA_NO_ERROR;
-    size_t pixel_count = (size_t)info->width * info->height;
-    bool is_run_length_packet = false;
-    uint8_t packet_count = 0;
-    uint8_t pixel_buffer[is_color_mapped ? map->bytes_per_entry : pixel_size];
-    // The actual pixel size of the image, In order not to be confused with the
-    // name of the parameter pixel_size, named data element.
-    uint8_t data_element_size = pixel_format_to_pixel_size(info->pixel_format);
-
-    for (; pixel_count > 0; --pixel_count) {
-        if (packet_count == 0) {
-            uint8_t repetition_count_field;
-            if (fread(&repetition_count_field, 1, 1, file) != 1) {
-                error_code = TGA_ERROR_FILE_CANNOT_READ;
-                break;
-            }
-            is_run_length_packet = repetition_count_field & 0x80;
-            packet_count = (repetition_count_field & 0x7F) + 1;
-            if (is_run_length_packet) {
-                if (fread(pixel_buffer, 1, pixel_size, file) != pixel_size) {
-                    error_code = TGA_ERROR_FILE_CANNOT_READ;
-                    break;
-                }
-                if (is_color_mapped) {
-                    // In color mapped image, the pixel as the index value of
-                    // the color map. The actual pixel value is found from the
-                    // color map.
-                    uint16_t index = pixel_to_map_index(pixel_buffer);
-                    if (try_get_color_from_map(pixel_buffer, index, map)) {
-                        error_code = TGA_ERROR_COLOR_MAP_INDEX_FAILED;
-                        break;
-                    }
-                }
+// Fills `count` pixels at `dest` with the same pixel value.
+static inline void fill_pixels(uint8_t *dest, const uint8_t *pixel,
+                               size_t count, int pixel_size) {
+    switch (pixel_size) {
+        case 1:
+            memset(dest, pixel[0], count);
+            break;
+        case 2: {
+            uint16_t value;
+            memcpy(&value, pixel, 2);
+            for (size_t i = 0; i < count; ++i) {
+                memcpy(dest + i * 2, &value, 2);
             }
+            break;
         }
-
-        if (is_run_length_packet) {
-            memcpy(data, pixel_buffer, data_element_size);
-        } else {
-            if (fread(data, 1, pixel_size, file) != pixel_size) {
-                error_code = TGA_ERROR_FILE_CANNOT_READ;
-                break;
+        case 3: {
+            // Copies 4 pixels at once with 3 32-bit stores.
+            uint8_t pattern[12];
+            for (int i = 0; i < 12; i += 3) {
+                memcpy(pattern + i, pixel, 3);
             }
-            if (is_color_mapped) {
-                // Again, in color mapped image, the pixel as the index value of
-                // the color map. The actual pixel value is found from the color
-                // map.
-                uint16_t index = pixel_to_map_index(data);
-                if (try_get_color_from_map(data, index, map)) {
-                    error_code = TGA_ERROR_COLOR_MAP_INDEX_FAILED;
-                    break;
-                }
+            uint32_t values[3];
+            memcpy(values, pattern, 12);
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                memcpy(dest + i * 3, values, 12);
+            }
+            for (; i < count; ++i) {
+                memcpy(dest + i * 3, pixel, 3);
             }
+            break;
+        }
+        case 4: {
+            uint32_t value;
+            memcpy(&value, pixel, 4);
+            for (size_t i = 0; i < count; ++i) {
+                memcpy(dest + i * 4, &value, 4);
+            }
+            break;
         }
-
-        --packet_count;
-        data += data_element_size;
     }
-    return error_code;
 }
 
-static enum tga_error load_image(uint8_t **data_out, tga_info **info_out,
-                                 FILE *file) {
-    struct tga_header header;
-    enum tga_pixel_format pixel_format;
-    enum tga_error error_code;
+// State of the image data decoding. The image data is decoded scanline by
+// scanline, the state of the RLE packet is carried over to the next scanline
+// because a packet may cross scanlines.
+struct decoder {
+    struct data_source *source;
+    uint16_t width;
+    // The bytes per pixel in the file.
+    uint8_t pixel_size;
+    // The actual pixel size of the image, In order not to be confused with the
+    // name pixel_size, named data element.
+    uint8_t data_element_size;
+    bool is_rle;
+    bool is_color_mapped;
+    // The pixels in the file are stored from right to left.
+    bool flip_h;
+    const struct color_map *map;
 
-    error_code = load_header(&header, &pixel_format, file);
-    if (error_code != TGA_NO_ERROR) {
-        return error_code;
+    // Number of pixels left in the current RLE packet.
+    int packet_count;
+    bool is_run_length_packet;
+    uint8_t pixel_buffer[4];
+};
+
+// The format is the pixel format the decoder outputs, which is the format of
+// the file (or TGA_PIXEL_INDEX8 if the color map is kept).
+static void init_decoder(struct decoder *decoder,
+                         const struct tga_header *header, int width,
+                         enum tga_pixel_format format,
+                         const struct color_map *map,
+                         struct data_source *source) {
+    decoder->source = source;
+    decoder->width = width;
+    decoder->pixel_size = BITS_TO_BYTES(header->pixel_depth);
+    decoder->data_element_size = pixel_format_to_pixel_size(format);
+    decoder->is_rle = IS_RLE(*header);
+    // The indices are stored as they are if the color map is kept.
+    decoder->is_color_mapped =
+        IS_COLOR_MAPPED(*header) && format != TGA_PIXEL_INDEX8;
+    decoder->flip_h = header->image_descriptor & 0x10;
+    decoder->map = map;
+    decoder->packet_count = 0;
+    decoder->is_run_length_packet = false;
+}
+
+// Decodes `count` color mapped pixels from the source to `dest`.
+static enum tga_error decode_color_mapped(uint8_t *dest, int count,
+                                          const struct decoder *decoder) {
+    // In color mapped image, the pixel as the index value of the color map.
+    // The actual pixel value is found from the color map. The indices are
+    // read and expanded in blocks.
+    uint8_t indices[1024];
+    while (count > 0) {
+        int block_size = count < 1024 ? count : 1024;
+        if (read_bytes(decoder->source, indices, block_size)) {
+            return TGA_ERROR_FILE_CANNOT_READ;
+        }
+        if (expand_indices(dest, indices, block_size, decoder->map)) {
+            return TGA_ERROR_COLOR_MAP_INDEX_FAILED;
+        }
+        dest += (size_t)block_size * decoder->data_element_size;
+        count -= block_size;
     }
-    // No need to handle the content of the ID field, so skip directly.
-    if (fseek(file, header.id_length, SEEK_CUR)) {
+    return TGA_NO_ERROR;
+}
+
+// Decodes a scanline of image data from the source.
+static enum tga_error decode_data(uint8_t *row, struct decoder *decoder) {
+    if (decoder->is_color_mapped) {
+        return decode_color_mapped(row, decoder->width, decoder);
+    }
+    size_t row_size = (size_t)decoder->width * decoder->pixel_size;
+    if (read_bytes(decoder->source, row, row_size)) {
         return TGA_ERROR_FILE_CANNOT_READ;
     }
+    return TGA_NO_ERROR;
+}
 
-    bool is_color_mapped = IS_COLOR_MAPPED(header);
-    bool is_rle = IS_RLE(header);
-
-    // Handle color map field.
-    struct color_map color_map;
-    color_map.pixels = NULL;
-    size_t map_size = header.map_length * BITS_TO_BYTES(header.map_entry_size);
-    if (is_color_mapped) {
-        color_map.first_index = header.map_first_entry;
-        color_map.entry_count = header.map_length;
-        color_map.bytes_per_entry = BITS_TO_BYTES(header.map_entry_size);
-        color_map.pixels = (uint8_t *)malloc(map_size);
-        if (color_map.pixels == NULL) {
-            return TGA_ERROR_OUT_OF_MEMORY;
-        }
-        if (fread(color_map.pixels, 1, map_size, file) != map_size) {
-            free(color_map.pixels);
+// Reads the header of the next RLE packet, and the pixel value if it is a run
+// length packet.
+static enum tga_error read_packet_header(struct decoder *decoder) {
+    uint8_t repetition_count_field;
+    if (read_bytes(decoder->source, &repetition_count_field, 1)) {
+        return TGA_ERROR_FILE_CANNOT_READ;
+    }
+    decoder->is_run_length_packet = repetition_count_field & 0x80;
+    decoder->packet_count = (repetition_count_field & 0x7F) + 1;
+    if (decoder->is_run_length_packet) {
+        if (read_bytes(decoder->source, decoder->pixel_buffer,
+                       decoder->pixel_size)) {
             return TGA_ERROR_FILE_CANNOT_READ;
         }
-    } else if (header.map_type == 1) {
-        // The image is not color mapped at this time, but contains a color map.
-        // So skips the color map data block directly.
-        if (fseek(file, map_size, SEEK_CUR)) {
-            return TGA_ERROR_FILE_CANNOT_READ;
+        if (decoder->is_color_mapped) {
+            // In color mapped image, the pixel as the index value of the color
+            // map. The actual pixel value is found from the color map.
+            uint8_t index = decoder->pixel_buffer[0];
+            if (expand_indices(decoder->pixel_buffer, &index, 1,
+                               decoder->map)) {
+                return TGA_ERROR_COLOR_MAP_INDEX_FAILED;
+            }
         }
     }
+    return TGA_NO_ERROR;
+}
 
-    uint8_t *data;
-    tga_info *info;
-    error_code = tga_create(&data, &info, header.image_width,
-                            header.image_height, pixel_format);
-    if (error_code != TGA_NO_ERROR) {
-        free(color_map.pixels);
-        return error_code;
+// Decodes a scanline of image data with run-length encoding from the source.
+static enum tga_error decode_data_rle(uint8_t *row, struct decoder *decoder) {
+    uint8_t element_size = decoder->data_element_size;
+    int pixel_count = decoder->width;
+
+    while (pixel_count > 0) {
+        if (decoder->packet_count == 0) {
+            enum tga_error error_code = read_packet_header(decoder);
+            if (error_code != TGA_NO_ERROR) {
+                return error_code;
+            }
+        }
+
+        // The rest of the packet continues on the next scanline.
+        int count = decoder->packet_count < pixel_count ? decoder->packet_count
+                                                        : pixel_count;
+        if (decoder->is_run_length_packet) {
+            fill_pixels(row, decoder->pixel_buffer, count, element_size);
+        } else if (decoder->is_color_mapped) {
+            enum tga_error error_code =
+                decode_color_mapped(row, count, decoder);
+            if (error_code != TGA_NO_ERROR) {
+                return error_code;
+            }
+        } else {
+            // The raw packet can be copied as a whole.
+            if (read_bytes(decoder->source, row,
+                           (size_t)count * decoder->pixel_size)) {
+                return TGA_ERROR_FILE_CANNOT_READ;
+            }
+        }
+
+        decoder->packet_count -= count;
+        pixel_count -= count;
+        row += (size_t)count * element_size;
     }
+    return TGA_NO_ERROR;
+}
 
-    // Load image data.
-    uint8_t pixel_size = BITS_TO_BYTES(header.pixel_depth);
-    if (is_rle) {
-        error_code = decode_data_rle(data, info, pixel_size, is_color_mapped,
-                                     &color_map, file);
+// Decodes the next scanline in the file to `row`, the pixels are stored from
+// left to right.
+static enum tga_error decode_scanline(uint8_t *row, struct decoder *decoder) {
+    enum tga_error error_code;
+    if (decoder->is_rle) {
+        error_code = decode_data_rle(row, decoder);
     } else {
-        error_code = decode_data(data, info, pixel_size, is_color_mapped,
-                                 &color_map, file);
+        error_code = decode_data(row, decoder);
     }
-    free(color_map.pixels);
-    if (error_code != TGA_NO_ERROR) {
-        tga_free_data(data);
-        tga_free_info(info);
-        return error_code;
+    if (error_code == TGA_NO_ERROR && decoder->flip_h) {
+        // Reverses the row while it is still in the cache.
+        reverse_row(row, decoder->width, decoder->data_element_size);
     }
+    return error_code;
+}
 
-    // Flip the image if necessary, to keep the origin in upper left corner.
-    bool flip_h = header.image_descriptor & 0x10;
-    bool flip_v = !(header.image_descriptor & 0x20);
-    if (flip_h) {
-        tga_image_flip_h(data, info);
-    }
-    if (flip_v) {
-        tga_image_flip_v(data, info);
-    }
+// Number of pixels converted at a time through the ARGB32 intermediate buffer.
+#define CONVERT_BLOCK_SIZE 256
 
-    *data_out = data;
-    *info_out = info;
-    return TGA_NO_ERROR;
-}
+// Assembles an ARGB32 pixel value, whose bytes are B, G, R, A in memory order.
+#define MAKE_ARGB(a, r, g, b)                                         \
+    ((uint32_t)(a) << 24 | (uint32_t)(r) << 16 | (uint32_t)(g) << 8 | \
+     (uint32_t)(b))
 
-// Returns the pixel at coordinates (x,y) for reading or writing.
+// Expands a 5-bit channel to 8 bits, so that 0x1F becomes 0xFF.
+#define EXPAND_5_BITS(value) ((value) << 3 | (value) >> 2)
+
+// Converts `count` pixels of the format to ARGB32 values.
+static void pixels_to_argb32(uint32_t *dest, const uint8_t *src,
+                             enum tga_pixel_format format, int count) {
+    switch (format) {
+        case TGA_PIXEL_BW8:
+            for (int i = 0; i < count; ++i) {
+                dest[i] = MAKE_ARGB(0xFF, src[i], src[i], src[i]);
+            }
+            break;
+        case TGA_PIXEL_BW16:
+            // Keeps the high byte of the little-endian value.
+            for (int i = 0; i < count; ++i) {
+                uint8_t value = src[i * 2 + 1];
+                dest[i] = MAKE_ARGB(0xFF, value, value, value);
+            }
+            break;
+        case TGA_PIXEL_RGB555:
+            // The attribute bit is ignored, the pixels are opaque.
+            for (int i = 0; i < count; ++i) {
+                uint32_t value = src[i * 2] | src[i * 2 + 1] << 8;
+                uint32_t r = (value >> 10) & 0x1F;
+                uint32_t g = (value >> 5) & 0x1F;
+                uint32_t b = value & 0x1F;
+                dest[i] = MAKE_ARGB(0xFF, EXPAND_5_BITS(r), EXPAND_5_BITS(g),
+                                    EXPAND_5_BITS(b));
+            }
+            break;
+        case TGA_PIXEL_RGB24:
+            for (int i = 0; i < count; ++i) {
+                const uint8_t *p = src + i * 3;
+                dest[i] = MAKE_ARGB(0xFF, p[2], p[1], p[0]);
+            }
+            break;
+        case TGA_PIXEL_ARGB32:
+            for (int i = 0; i < count; ++i) {
+                const uint8_t *p = src + i * 4;
+                dest[i] = MAKE_ARGB(p[3], p[2], p[1], p[0]);
+            }
+            break;
+        case TGA_PIXEL_ABGR32:
+            for (int i = 0; i < count; ++i) {
+                const uint8_t *p = src + i * 4;
+                dest[i] = MAKE_ARGB(p[3], p[0], p[1], p[2]);
+            }
+            break;
+        case TGA_PIXEL_ARGB64:
+            // Rounds each 16-bit channel to the nearest 8-bit value.
+            for (int i = 0; i < count; ++i) {
+                const uint8_t *p = src + i * 8;
+                uint32_t channels[4];
+                for (int c = 0; c < 4; ++c) {
+                    uint32_t value = p[c * 2] | p[c * 2 + 1] << 8;
+                    channels[c] = (value * 255 + 32767) / 65535;
+                }
+                dest[i] = MAKE_ARGB(channels[3], channels[2], channels[1],
+                                    channels[0]);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Converts `count` ARGB32 values to pixels of the format.
+static void pixels_from_argb32(uint8_t *dest, enum tga_pixel_format format,
+                               const uint32_t *src, int count) {
+    switch (format) {
+        case TGA_PIXEL_BW8:
+        case TGA_PIXEL_BW16:
+            for (int i = 0; i < count; ++i) {
+                // The luma of BT.601 in 16-bit fixed point, the weights sum to
+                // 65536 so that a gray pixel keeps its value.
+                uint32_t r = (src[i] >> 16) & 0xFF;
+                uint32_t g = (src[i] >> 8) & 0xFF;
+                uint32_t b = src[i] & 0xFF;
+                uint8_t y =
+                    (uint8_t)((r * 19595 + g * 38470 + b * 7471 + 32768) >> 16);
+                if (format == TGA_PIXEL_BW8) {
+                    dest[i] = y;
+                } else {
+                    // y * 257 maps 0xFF to 0xFFFF.
+                    dest[i * 2] = y;
+                    dest[i * 2 + 1] = y;
+                }
+            }
+            break;
+        case TGA_PIXEL_RGB555:
+            // The attribute bit is 0.
+            for (int i = 0; i < count; ++i) {
+                uint32_t value = (src[i] >> 9) & 0x7C00;
+                value |= (src[i] >> 6) & 0x03E0;
+                value |= (src[i] >> 3) & 0x001F;
+                dest[i * 2] = value & 0xFF;
+                dest[i * 2 + 1] = (uint8_t)(value >> 8);
+            }
+            break;
+        case TGA_PIXEL_RGB24:
+            for (int i = 0; i < count; ++i) {
+                uint8_t *p = dest + i * 3;
+                p[0] = src[i] & 0xFF;
+                p[1] = (src[i] >> 8) & 0xFF;
+                p[2] = (src[i] >> 16) & 0xFF;
+            }
+            break;
+        case TGA_PIXEL_ARGB32:
+            for (int i = 0; i < count; ++i) {
+                uint8_t *p = dest + i * 4;
+                p[0] = src[i] & 0xFF;
+                p[1] = (src[i] >> 8) & 0xFF;
+                p[2] = (src[i] >> 16) & 0xFF;
+                p[3] = (uint8_t)(src[i] >> 24);
+            }
+            break;
+        case TGA_PIXEL_ABGR32:
+            for (int i = 0; i < count; ++i) {
+                uint8_t *p = dest + i * 4;
+                p[0] = (src[i] >> 16) & 0xFF;
+                p[1] = (src[i] >> 8) & 0xFF;
+                p[2] = src[i] & 0xFF;
+                p[3] = (uint8_t)(src[i] >> 24);
+            }
+            break;
+        case TGA_PIXEL_ARGB64:
+            // value * 257 maps 0xFF to 0xFFFF, both bytes are the value.
+            for (int i = 0; i < count; ++i) {
+                uint8_t *p = dest + i * 8;
+                for (int c = 0; c < 4; ++c) {
+                    uint8_t value = (src[i] >> (c * 8)) & 0xFF;
+                    p[c * 2] = value;
+                    p[c * 2 + 1] = value;
+                }
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+#ifdef HAS_SSE2
+
+// Swaps the first and the third byte of each of the 4 pixels.
+static inline __m128i swap_red_blue_epi32(__m128i pixels) {
+    const __m128i green_alpha_mask = _mm_set1_epi32((int)0xFF00FF00);
+    const __m128i low_byte_mask = _mm_set1_epi32(0xFF);
+    __m128i green_alpha = _mm_and_si128(pixels, green_alpha_mask);
+    __m128i red = _mm_and_si128(_mm_srli_epi32(pixels, 16), low_byte_mask);
+    __m128i blue = _mm_slli_epi32(_mm_and_si128(pixels, low_byte_mask), 16);
+    return _mm_or_si128(green_alpha, _mm_or_si128(red, blue));
+}
+
+// Swaps the first and the third byte of each 4-byte pixel, 4 pixels at a time.
+// Returns the number of pixels swapped.
+static int swap_red_blue_sse2(uint8_t *dest, const uint8_t *src, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        _mm_storeu_si128((__m128i *)(dest + i * 4),
+                         swap_red_blue_epi32(pixels));
+    }
+    return i;
+}
+
+// Converts TGA_PIXEL_BW8 pixels to 4-byte pixels, 16 pixels at a time. The
+// result is the same in TGA_PIXEL_ARGB32 and TGA_PIXEL_ABGR32.
+// Returns the number of pixels converted.
+static int bw8_to_32_sse2(uint8_t *dest, const uint8_t *src, int count) {
+    const __m128i alpha = _mm_set1_epi8((char)0xFF);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i gray = _mm_loadu_si128((const __m128i *)(src + i));
+        // Pairs of gray bytes, and pairs of gray and alpha bytes, which are
+        // interleaved to the pixels.
+        __m128i gray_lo = _mm_unpacklo_epi8(gray, gray);
+        __m128i gray_hi = _mm_unpackhi_epi8(gray, gray);
+        __m128i alpha_lo = _mm_unpacklo_epi8(gray, alpha);
+        __m128i alpha_hi = _mm_unpackhi_epi8(gray, alpha);
+        __m128i *q = (__m128i *)(dest + i * 4);
+        _mm_storeu_si128(q, _mm_unpacklo_epi16(gray_lo, alpha_lo));
+        _mm_storeu_si128(q + 1, _mm_unpackhi_epi16(gray_lo, alpha_lo));
+        _mm_storeu_si128(q + 2, _mm_unpacklo_epi16(gray_hi, alpha_hi));
+        _mm_storeu_si128(q + 3, _mm_unpackhi_epi16(gray_hi, alpha_hi));
+    }
+    return i;
+}
+
+// Expands 5-bit channels in 16-bit lanes to 8 bits, as EXPAND_5_BITS().
+static inline __m128i expand_5_bits_epi16(__m128i value) {
+    return _mm_or_si128(_mm_slli_epi16(value, 3), _mm_srli_epi16(value, 2));
+}
+
+// Converts TGA_PIXEL_RGB555 pixels to TGA_PIXEL_ARGB32, or TGA_PIXEL_ABGR32 if
+// is_swapped is true, 8 pixels at a time. The attribute bit is ignored.
+// Returns the number of pixels converted.
+static int rgb555_to_32_sse2(uint8_t *dest, bool is_swapped,
+                             const uint8_t *src, int count) {
+    const __m128i channel_mask = _mm_set1_epi16(0x1F);
+    const __m128i alpha = _mm_set1_epi16((short)0xFF00);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i value = _mm_loadu_si128((const __m128i *)(src + i * 2));
+        __m128i blue = expand_5_bits_epi16(_mm_and_si128(value, channel_mask));
+        __m128i green = expand_5_bits_epi16(
+            _mm_and_si128(_mm_srli_epi16(value, 5), channel_mask));
+        __m128i red = expand_5_bits_epi16(
+            _mm_and_si128(_mm_srli_epi16(value, 10), channel_mask));
+        if (is_swapped) {
+            __m128i temp = red;
+            red = blue;
+            blue = temp;
+        }
+        // The first two and the last two bytes of each pixel.
+        __m128i low = _mm_or_si128(blue, _mm_slli_epi16(green, 8));
+        __m128i high = _mm_or_si128(red, alpha);
+        __m128i *q = (__m128i *)(dest + i * 4);
+        _mm_storeu_si128(q, _mm_unpacklo_epi16(low, high));
+        _mm_storeu_si128(q + 1, _mm_unpackhi_epi16(low, high));
+    }
+    return i;
+}
+
+// Converts TGA_PIXEL_RGB24 pixels to TGA_PIXEL_ARGB32, or TGA_PIXEL_ABGR32 if
+// is_swapped is true, 4 pixels at a time. Each load reads 16 bytes for the 12
+// bytes of 4 pixels, so the last pixels are left to the scalar code.
+// Returns the number of pixels converted.
+static int rgb24_to_32_sse2(uint8_t *dest, bool is_swapped,
+                            const uint8_t *src, int count) {
+    // The 3 low bytes of each 32-bit lane.
+    const __m128i lane0 = _mm_set_epi32(0, 0, 0, 0xFFFFFF);
+    const __m128i lane1 = _mm_set_epi32(0, 0, 0xFFFFFF, 0);
+    const __m128i lane2 = _mm_set_epi32(0, 0xFFFFFF, 0, 0);
+    const __m128i lane3 = _mm_set_epi32(0xFFFFFF, 0, 0, 0);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+    int i = 0;
+    for (; (size_t)(i + 4) * 3 + 4 <= (size_t)count * 3; i += 4) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(src + i * 3));
+        // The pixel k starts at byte 3 * k, and moves to byte 4 * k.
+        __m128i pixels = _mm_and_si128(bytes, lane0);
+        pixels = _mm_or_si128(
+            pixels, _mm_and_si128(_mm_slli_si128(bytes, 1), lane1));
+        pixels = _mm_or_si128(
+            pixels, _mm_and_si128(_mm_slli_si128(bytes, 2), lane2));
+        pixels = _mm_or_si128(
+            pixels, _mm_and_si128(_mm_slli_si128(bytes, 3), lane3));
+        pixels = _mm_or_si128(pixels, alpha);
+        if (is_swapped) {
+            pixels = swap_red_blue_epi32(pixels);
+        }
+        _mm_storeu_si128((__m128i *)(dest + i * 4), pixels);
+    }
+    return i;
+}
+
+// Converts the pixels of the 8-bit formats to TGA_PIXEL_ARGB32 or
+// TGA_PIXEL_ABGR32 with the kernels above. Returns the number of pixels
+// converted, 0 if the pair of formats has no kernel.
+static int convert_to_32_sse2(uint8_t *dest, enum tga_pixel_format dest_format,
+                              const uint8_t *src,
+                              enum tga_pixel_format src_format, int count) {
+    if (dest_format != TGA_PIXEL_ARGB32 && dest_format != TGA_PIXEL_ABGR32) {
+        return 0;
+    }
+    bool is_swapped = dest_format == TGA_PIXEL_ABGR32;
+    switch (src_format) {
+        case TGA_PIXEL_BW8:
+            return bw8_to_32_sse2(dest, src, count);
+        case TGA_PIXEL_RGB555:
+            return rgb555_to_32_sse2(dest, is_swapped, src, count);
+        case TGA_PIXEL_RGB24:
+            return rgb24_to_32_sse2(dest, is_swapped, src, count);
+        default:
+            return 0;
+    }
+}
+
+#endif  // HAS_SSE2
+
+// Converts between TGA_PIXEL_ARGB32 and TGA_PIXEL_ABGR32, which only differ in
+// the order of the red and blue channels.
+static void swap_red_blue(uint8_t *dest, const uint8_t *src, int count) {
+    int i = 0;
+#ifdef HAS_SSE2
+    i = swap_red_blue_sse2(dest, src, count);
+#endif
+    for (; i < count; ++i) {
+        const uint8_t *p = src + i * 4;
+        uint8_t *q = dest + i * 4;
+        uint8_t red = p[2];
+        q[2] = p[0];
+        q[1] = p[1];
+        q[0] = red;
+        q[3] = p[3];
+    }
+}
+
+// Converts `count` pixels from src_format to dest_format. Both formats must
+// not be TGA_PIXEL_INDEX8, and the buffers must not overlap.
+static void convert_pixels(uint8_t *dest, enum tga_pixel_format dest_format,
+                           const uint8_t *src, enum tga_pixel_format src_format,
+                           int count) {
+    int dest_size = pixel_format_to_pixel_size(dest_format);
+    int src_size = pixel_format_to_pixel_size(src_format);
+    if (dest_format == src_format) {
+        memcpy(dest, src, (size_t)count * src_size);
+        return;
+    }
+    if ((dest_format == TGA_PIXEL_ARGB32 && src_format == TGA_PIXEL_ABGR32) ||
+        (dest_format == TGA_PIXEL_ABGR32 && src_format == TGA_PIXEL_ARGB32)) {
+        swap_red_blue(dest, src, count);
+        return;
+    }
+#ifdef HAS_SSE2
+    // The expansions to 4-byte pixels are vectorized, the pixels left over go
+    // through the block below.
+    int converted =
+        convert_to_32_sse2(dest, dest_format, src, src_format, count);
+    src += (size_t)converted * src_size;
+    dest += (size_t)converted * dest_size;
+    count -= converted;
+#endif
+    // The other pairs go through ARGB32 in blocks that stay in the cache.
+    uint32_t block[CONVERT_BLOCK_SIZE];
+    while (count > 0) {
+        int block_size =
+            count < CONVERT_BLOCK_SIZE ? count : CONVERT_BLOCK_SIZE;
+        pixels_to_argb32(block, src, src_format, block_size);
+        pixels_from_argb32(dest, dest_format, block, block_size);
+        src += (size_t)block_size * src_size;
+        dest += (size_t)block_size * dest_size;
+        count -= block_size;
+    }
+}
+
+// The sRGB transfer function decoded to linear 8-bit and 16-bit values.
+static const uint8_t srgb_to_linear8[256] = {
+      0,   0,   0,   0,   0,   0,   0,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   2,   2,   2,   2,   2,   2,   2,   2,   3,   3,   3,   3,
+      3,   3,   4,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,   6,
+      7,   7,   7,   8,   8,   8,   8,   9,   9,   9,  10,  10,  10,  11,  11,
+     12,  12,  12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  17,
+     18,  18,  19,  19,  20,  20,  21,  22,  22,  23,  23,  24,  24,  25,  25,
+     26,  27,  27,  28,  29,  29,  30,  30,  31,  32,  32,  33,  34,  35,  35,
+     36,  37,  37,  38,  39,  40,  41,  41,  42,  43,  44,  45,  45,  46,  47,
+     48,  49,  50,  51,  51,  52,  53,  54,  55,  56,  57,  58,  59,  60,  61,
+     62,  63,  64,  65,  66,  67,  68,  69,  70,  71,  72,  73,  74,  76,  77,
+     78,  79,  80,  81,  82,  84,  85,  86,  87,  88,  90,  91,  92,  93,  95,
+     96,  97,  99, 100, 101, 103, 104, 105, 107, 108, 109, 111, 112, 114, 115,
+    116, 118, 119, 121, 122, 124, 125, 127, 128, 130, 131, 133, 134, 136, 138,
+    139, 141, 142, 144, 146, 147, 149, 151, 152, 154, 156, 157, 159, 161, 163,
+    164, 166, 168, 170, 171, 173, 175, 177, 179, 181, 183, 184, 186, 188, 190,
+    192, 194, 196, 198, 200, 202, 204, 206, 208, 210, 212, 214, 216, 218, 220,
+    222, 224, 226, 229, 231, 233, 235, 237, 239, 242, 244, 246, 248, 250, 253,
+    255,
+};
+
+static const uint16_t srgb_to_linear16[256] = {
+        0,    20,    40,    60,    80,    99,   119,   139,   159,   179,   199,
+      219,   241,   264,   288,   313,   340,   367,   396,   427,   458,   491,
+      526,   562,   599,   637,   677,   718,   761,   805,   851,   898,   947,
+      997,  1048,  1101,  1156,  1212,  1270,  1330,  1391,  1453,  1517,  1583,
+     1651,  1720,  1790,  1863,  1937,  2013,  2090,  2170,  2250,  2333,  2418,
+     2504,  2592,  2681,  2773,  2866,  2961,  3058,  3157,  3258,  3360,  3464,
+     3570,  3678,  3788,  3900,  4014,  4129,  4247,  4366,  4488,  4611,  4736,
+     4864,  4993,  5124,  5257,  5392,  5530,  5669,  5810,  5953,  6099,  6246,
+     6395,  6547,  6700,  6856,  7014,  7174,  7335,  7500,  7666,  7834,  8004,
+     8177,  8352,  8528,  8708,  8889,  9072,  9258,  9445,  9635,  9828, 10022,
+    10219, 10417, 10619, 10822, 11028, 11235, 11446, 11658, 11873, 12090, 12309,
+    12530, 12754, 12980, 13209, 13440, 13673, 13909, 14146, 14387, 14629, 14874,
+    15122, 15371, 15623, 15878, 16135, 16394, 16656, 16920, 17187, 17456, 17727,
+    18001, 18277, 18556, 18837, 19121, 19407, 19696, 19987, 20281, 20577, 20876,
+    21177, 21481, 21787, 22096, 22407, 22721, 23038, 23357, 23678, 24002, 24329,
+    24658, 24990, 25325, 25662, 26001, 26344, 26688, 27036, 27386, 27739, 28094,
+    28452, 28813, 29176, 29542, 29911, 30282, 30656, 31033, 31412, 31794, 32179,
+    32567, 32957, 33350, 33745, 34143, 34544, 34948, 35355, 35764, 36176, 36591,
+    37008, 37429, 37852, 38278, 38706, 39138, 39572, 40009, 40449, 40891, 41337,
+    41785, 42236, 42690, 43147, 43606, 44069, 44534, 45002, 45473, 45947, 46423,
+    46903, 47385, 47871, 48359, 48850, 49344, 49841, 50341, 50844, 51349, 51858,
+    52369, 52884, 53401, 53921, 54445, 54971, 55500, 56032, 56567, 57105, 57646,
+    58190, 58737, 59287, 59840, 60396, 60955, 61517, 62082, 62650, 63221, 63795,
+    64372, 64952, 65535,
+};
+
+// Decodes the sRGB color channels to linear values in place, the alpha channel
+// is already linear.
+static void linearize_pixels(uint8_t *pixels, enum tga_pixel_format format,
+                             int count) {
+    switch (format) {
+        case TGA_PIXEL_BW8:
+            for (int i = 0; i < count; ++i) {
+                pixels[i] = srgb_to_linear8[pixels[i]];
+            }
+            break;
+        case TGA_PIXEL_RGB24:
+            for (int i = 0; i < count * 3; ++i) {
+                pixels[i] = srgb_to_linear8[pixels[i]];
+            }
+            break;
+        case TGA_PIXEL_ARGB32:
+        case TGA_PIXEL_ABGR32:
+            for (int i = 0; i < count; ++i) {
+                uint8_t *p = pixels + i * 4;
+                p[0] = srgb_to_linear8[p[0]];
+                p[1] = srgb_to_linear8[p[1]];
+                p[2] = srgb_to_linear8[p[2]];
+            }
+            break;
+        case TGA_PIXEL_ARGB64:
+            // The channels hold 8-bit values scaled by 257, so the high byte
+            // indexes the 16-bit table without losing precision.
+            for (int i = 0; i < count; ++i) {
+                uint8_t *p = pixels + i * 8;
+                for (int c = 0; c < 3; ++c) {
+                    uint16_t value = srgb_to_linear16[p[c * 2 + 1]];
+                    p[c * 2] = value & 0xFF;
+                    p[c * 2 + 1] = (uint8_t)(value >> 8);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Multiplies an 8-bit channel by an 8-bit alpha, rounded to nearest.
+#define MULTIPLY_ALPHA8(channel, alpha) \
+    ((((channel) * (alpha) + 128) + (((channel) * (alpha) + 128) >> 8)) >> 8)
+
+#ifdef HAS_SSE2
+
+// Premultiplies 4-byte pixels whose alpha is the last byte, 4 pixels at a
+// time. Returns the number of pixels premultiplied.
+static int premultiply_pixels_sse2(uint8_t *pixels, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi16(128);
+    const __m128i alpha_mask = _mm_set1_epi32((int)0xFF000000);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i source = _mm_loadu_si128((const __m128i *)(pixels + i * 4));
+        __m128i halves[2] = {_mm_unpacklo_epi8(source, zero),
+                             _mm_unpackhi_epi8(source, zero)};
+        for (int h = 0; h < 2; ++h) {
+            // Broadcasts the alpha of each pixel to its 4 lanes.
+            __m128i alpha = _mm_shufflelo_epi16(halves[h], 0xFF);
+            alpha = _mm_shufflehi_epi16(alpha, 0xFF);
+            __m128i product =
+                _mm_add_epi16(_mm_mullo_epi16(halves[h], alpha), rounding);
+            product = _mm_add_epi16(product, _mm_srli_epi16(product, 8));
+            halves[h] = _mm_srli_epi16(product, 8);
+        }
+        __m128i result = _mm_packus_epi16(halves[0], halves[1]);
+        // Keeps the alpha channel, which has been multiplied by itself.
+        result = _mm_or_si128(_mm_andnot_si128(alpha_mask, result),
+                              _mm_and_si128(alpha_mask, source));
+        _mm_storeu_si128((__m128i *)(pixels + i * 4), result);
+    }
+    return i;
+}
+
+#endif  // HAS_SSE2
+
+// Multiplies the color channels by the alpha channel in place. The formats
+// without alpha channel are opaque, so they are not changed.
+static void premultiply_pixels(uint8_t *pixels, enum tga_pixel_format format,
+                               int count) {
+    if (format == TGA_PIXEL_ARGB32 || format == TGA_PIXEL_ABGR32) {
+        int i = 0;
+#ifdef HAS_SSE2
+        i = premultiply_pixels_sse2(pixels, count);
+#endif
+        for (; i < count; ++i) {
+            uint8_t *p = pixels + i * 4;
+            uint32_t alpha = p[3];
+            p[0] = (uint8_t)MULTIPLY_ALPHA8(p[0], alpha);
+            p[1] = (uint8_t)MULTIPLY_ALPHA8(p[1], alpha);
+            p[2] = (uint8_t)MULTIPLY_ALPHA8(p[2], alpha);
+        }
+    } else if (format == TGA_PIXEL_ARGB64) {
+        for (int i = 0; i < count; ++i) {
+            uint8_t *p = pixels + i * 8;
+            uint32_t alpha = p[6] | p[7] << 8;
+            for (int c = 0; c < 3; ++c) {
+                uint32_t value = (uint32_t)(p[c * 2] | p[c * 2 + 1] << 8);
+                // Divides by 65535 rounded to nearest, without overflow.
+                value = value * alpha + 32768;
+                value = (value + (value >> 16)) >> 16;
+                p[c * 2] = value & 0xFF;
+                p[c * 2 + 1] = (uint8_t)(value >> 8);
+            }
+        }
+    }
+}
+
+// The load flags that transform the pixels after the conversion.
+#define TRANSFORM_FLAGS (TGA_LOAD_LINEARIZE | TGA_LOAD_PREMULTIPLY)
+
+// Applies the transforms of the load flags to the pixels in place. The colors
+// are linearized before they are multiplied by the alpha.
+static void transform_pixels(uint8_t *pixels, enum tga_pixel_format format,
+                             int count, unsigned int transforms) {
+    if (transforms & TGA_LOAD_LINEARIZE) {
+        linearize_pixels(pixels, format, count);
+    }
+    if (transforms & TGA_LOAD_PREMULTIPLY) {
+        premultiply_pixels(pixels, format, count);
+    }
+}
+
+// Converts the decoded scanlines to the format of the image.
+struct row_converter {
+    enum tga_pixel_format decoded_format;
+    enum tga_pixel_format format;
+    int width;
+    // The TRANSFORM_FLAGS of the load options.
+    unsigned int transforms;
+    // Holds a decoded scanline, null if the formats are the same.
+    uint8_t *row;
+};
+
+// Prepares the converter of scanlines of `width` pixels from the decoded format
+// to the format of the info. The row buffer is only needed while decoding, so
+// it is allocated by malloc() rather than the allocator of the info.
+// Returns false means no error, otherwise returns true (out of memory).
+static bool init_row_converter(struct row_converter *converter,
+                               const tga_info *info, int width,
+                               enum tga_pixel_format decoded_format,
+                               const struct tga_load_options *options) {
+    converter->decoded_format = decoded_format;
+    converter->format = info->pixel_format;
+    converter->width = width;
+    converter->transforms =
+        options != NULL ? options->flags & TRANSFORM_FLAGS : 0;
+    converter->row = NULL;
+    if (decoded_format != info->pixel_format) {
+        size_t row_size =
+            (size_t)width * pixel_format_to_pixel_size(decoded_format);
+        converter->row = (uint8_t *)malloc(row_size);
+        if (converter->row == NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void free_row_converter(struct row_converter *converter) {
+    free(converter->row);
+    converter->row = NULL;
+}
+
+// Decodes the next scanline to `row` in the format of the converter. The
+// scanline is converted and transformed while it is still in the cache.
+static enum tga_error decode_converted_scanline(
+    uint8_t *row, struct decoder *decoder,
+    const struct row_converter *converter) {
+    enum tga_error error_code;
+    if (converter->row == NULL) {
+        error_code = decode_scanline(row, decoder);
+    } else {
+        error_code = decode_scanline(converter->row, decoder);
+        if (error_code == TGA_NO_ERROR) {
+            convert_pixels(row, converter->format, converter->row,
+                           converter->decoded_format, converter->width);
+        }
+    }
+    if (error_code == TGA_NO_ERROR && converter->transforms != 0) {
+        transform_pixels(row, converter->format, converter->width,
+                         converter->transforms);
+    }
+    return error_code;
+}
+
+// Gets the format of the loaded image, which is the decoded format unless the
+// options ask for a conversion.
+// Returns false means no error, otherwise returns true (the conversion or the
+// transforms are not supported).
+static bool get_image_format(enum tga_pixel_format *image_format,
+                             enum tga_pixel_format decoded_format,
+                             const struct tga_load_options *options) {
+    *image_format = decoded_format;
+    if (options == NULL) {
+        return false;
+    }
+    if (options->flags & TGA_LOAD_CONVERT) {
+        *image_format = options->pixel_format;
+        if (pixel_format_to_pixel_size(*image_format) == -1) {
+            return true;
+        }
+        // The indices cannot be converted without the color map.
+        if (*image_format != decoded_format &&
+            (*image_format == TGA_PIXEL_INDEX8 ||
+             decoded_format == TGA_PIXEL_INDEX8)) {
+            return true;
+        }
+    }
+    if ((options->flags & TRANSFORM_FLAGS) &&
+        *image_format == TGA_PIXEL_INDEX8) {
+        return true;
+    }
+    // The 16-bit formats other than TGA_PIXEL_ARGB64 would lose the precision
+    // of the linear values.
+    return (options->flags & TGA_LOAD_LINEARIZE) &&
+           (*image_format == TGA_PIXEL_BW16 ||
+            *image_format == TGA_PIXEL_RGB555);
+}
+
+// Reads the header, the ID field and the color map field from the source, and
+// leaves the source at the beginning of the image data. If the image is color
+// mapped, the color map must be released with deallocate() by the caller.
+static enum tga_error load_image_prologue(
+    struct tga_header *header, enum tga_pixel_format *pixel_format,
+    struct color_map *color_map, struct data_source *source,
+    const struct tga_load_options *options) {
+    color_map->pixels = NULL;
+    enum tga_error error_code = load_header(header, pixel_format, source);
+    if (error_code != TGA_NO_ERROR) {
+        return error_code;
+    }
+    // No need to handle the content of the ID field, so skip directly.
+    if (skip_bytes(source, header->id_length)) {
+        return TGA_ERROR_FILE_CANNOT_READ;
+    }
+    bool keep_color_map = options != NULL &&
+                          (options->flags & TGA_LOAD_KEEP_COLOR_MAP) &&
+                          IS_COLOR_MAPPED(*header);
+    const struct tga_allocator *allocator =
+        options != NULL ? options->allocator : NULL;
+    if (keep_color_map) {
+        *pixel_format = TGA_PIXEL_INDEX8;
+    }
+
+    // Handle color map field.
+    size_t map_size =
+        header->map_length * BITS_TO_BYTES(header->map_entry_size);
+    if (IS_COLOR_MAPPED(*header)) {
+        color_map->first_index = header->map_first_entry;
+        color_map->entry_count = header->map_length;
+        color_map->bytes_per_entry = BITS_TO_BYTES(header->map_entry_size);
+        color_map->pixels = (uint8_t *)allocate(allocator, map_size);
+        if (color_map->pixels == NULL) {
+            return TGA_ERROR_OUT_OF_MEMORY;
+        }
+        if (read_bytes(source, color_map->pixels, map_size)) {
+            deallocate(allocator, color_map->pixels);
+            color_map->pixels = NULL;
+            return TGA_ERROR_FILE_CANNOT_READ;
+        }
+        if (!keep_color_map) {
+            init_lookup_table(color_map);
+        }
+    } else if (header->map_type == 1) {
+        // The image is not color mapped at this time, but contains a color map.
+        // So skips the color map data block directly.
+        if (skip_bytes(source, map_size)) {
+            return TGA_ERROR_FILE_CANNOT_READ;
+        }
+    }
+    return TGA_NO_ERROR;
+}
+
+// Moves the color map to the info structure of a TGA_PIXEL_INDEX8 format
+// image, does nothing for other formats.
+static void attach_color_map(tga_info *info, struct color_map *color_map) {
+    if (info->pixel_format != TGA_PIXEL_INDEX8) {
+        return;
+    }
+    info->color_map = color_map->pixels;
+    info->map_first_index = color_map->first_index;
+    info->map_length = color_map->entry_count;
+    info->map_entry_size = color_map->bytes_per_entry;
+    color_map->pixels = NULL;
+}
+
+// The upper limit of the threads used by a parallel operation.
+#define MAX_THREAD_COUNT 64
+
+// Clamps a thread count of the options to [1, MAX_THREAD_COUNT], so that the
+// number of bands derived from it cannot overflow.
+static int clamp_thread_count(int thread_count) {
+    if (thread_count < 1) {
+        return 1;
+    }
+    return thread_count > MAX_THREAD_COUNT ? MAX_THREAD_COUNT : thread_count;
+}
+
+#ifdef HAS_THREADS
+
+// A set of independent tasks, executed by run_parallel().
+struct parallel_job {
+    void (*task)(void *arg, int index);
+    void *arg;
+    int task_count;
+    // Index of the next task to be executed, protected by the mutex.
+    int next_task;
+    pthread_mutex_t mutex;
+};
+
+// Executes the tasks of the job one by one until all tasks are taken. The idle
+// threads take the next task, so the uneven tasks are balanced automatically.
+static void *parallel_worker(void *arg) {
+    struct parallel_job *job = (struct parallel_job *)arg;
+    for (;;) {
+        pthread_mutex_lock(&job->mutex);
+        int index = job->next_task++;
+        pthread_mutex_unlock(&job->mutex);
+        if (index >= job->task_count) {
+            break;
+        }
+        job->task(job->arg, index);
+    }
+    return NULL;
+}
+
+#endif  // HAS_THREADS
+
+// Calls task(arg, index) for every index in [0, task_count), using up to
+// thread_count threads (including the calling thread). Runs the tasks in
+// order on the calling thread if threads are not supported.
+static void run_parallel(void (*task)(void *arg, int index), void *arg,
+                         int task_count, int thread_count) {
+#ifdef HAS_THREADS
+    struct parallel_job job;
+    job.task = task;
+    job.arg = arg;
+    job.task_count = task_count;
+    if (thread_count > task_count) {
+        thread_count = task_count;
+    }
+    if (thread_count > MAX_THREAD_COUNT) {
+        thread_count = MAX_THREAD_COUNT;
+    }
+    if (thread_count > 1 && pthread_mutex_init(&job.mutex, NULL) == 0) {
+        job.next_task = 0;
+        pthread_t threads[MAX_THREAD_COUNT];
+        int created_count = 0;
+        for (int i = 1; i < thread_count; ++i) {
+            if (pthread_create(&threads[created_count], NULL, parallel_worker,
+                               &job) == 0) {
+                ++created_count;
+            }
+        }
+        // The calling thread works too, so the job is done even if no thread
+        // could be created.
+        parallel_worker(&job);
+        for (int i = 0; i < created_count; ++i) {
+            pthread_join(threads[i], NULL);
+        }
+        pthread_mutex_destroy(&job.mutex);
+        return;
+    }
+#else
+    (void)thread_count;
+#endif
+    for (int i = 0; i < task_count; ++i) {
+        task(arg, i);
+    }
+}
+
+// Loads an item of tga_load_batch(), is executed by run_parallel().
+static void load_batch_item(void *arg, int index) {
+    struct batch_job *job = (struct batch_job *)arg;
+    struct tga_batch_item *item = &job->items[index];
+    const struct tga_batch_options *options = job->options;
+    item->data = NULL;
+    item->info = NULL;
+    if (item->file_name != NULL) {
+        item->error_code = tga_load_with_options(
+            &item->data, &item->info, item->file_name, options->load_options);
+    } else {
+        item->error_code = tga_load_from_memory_with_options(
+            &item->data, &item->info, item->buffer, item->size,
+            options->load_options);
+    }
+    if (options->callback != NULL) {
+        options->callback(item, options->user_data);
+    }
+}
+
+// The minimum number of scanlines decoded by a parallel task.
+#define MIN_BAND_ROWS 16
+
+// Where the decoding of a scanline starts in the source.
+struct scanline_position {
+    // Byte offset of the data. For RLE images, it is the offset of the packet
+    // that contains the first pixel of the scanline.
+    size_t offset;
+    // Number of pixels of the packet that belong to the previous scanlines.
+    int skip_count;
+};
+
+// The image is divided into bands of scanlines, which are decoded in parallel.
+struct parallel_decoding {
+    uint8_t *data;
+    // Byte distance between the rows of data.
+    size_t stride;
+    const tga_info *info;
+    // The format output by the decoder, converted to the format of the info.
+    enum tga_pixel_format decoded_format;
+    const struct tga_load_options *options;
+    const struct tga_header *header;
+    const struct color_map *map;
+    // The whole TGA data in memory.
+    const uint8_t *buffer;
+    size_t size;
+    int band_rows;
+    struct scanline_position *band_positions;
+    enum tga_error *band_error_codes;
+};
+
+// Walks the RLE packets from the current position of the source, and records
+// the position of the first scanline of each band. Only the packet headers are
+// read, the pixels are not decoded.
+static enum tga_error index_rle_scanlines(struct parallel_decoding *decoding,
+                                          size_t position) {
+    int pixel_size = BITS_TO_BYTES(decoding->header->pixel_depth);
+    int width = decoding->info->width;
+    size_t packet_offset = 0;
+    int packet_size = 0;
+    // Number of pixels left in the current packet.
+    int packet_count = 0;
+    for (int y = 0; y < decoding->info->height; ++y) {
+        if (y % decoding->band_rows == 0) {
+            struct scanline_position *band_position =
+                &decoding->band_positions[y / decoding->band_rows];
+            if (packet_count > 0) {
+                band_position->offset = packet_offset;
+                band_position->skip_count = packet_size - packet_count;
+            } else {
+                band_position->offset = position;
+                band_position->skip_count = 0;
+            }
+        }
+        int pixel_count = width;
+        while (pixel_count > 0) {
+            if (packet_count == 0) {
+                if (position >= decoding->size) {
+                    return TGA_ERROR_FILE_CANNOT_READ;
+                }
+                uint8_t repetition_count_field = decoding->buffer[position];
+                packet_offset = position;
+                packet_size = (repetition_count_field & 0x7F) + 1;
+                packet_count = packet_size;
+                position += 1 + (repetition_count_field & 0x80
+                                     ? (size_t)pixel_size
+                                     : (size_t)packet_size * pixel_size);
+            }
+            int count = packet_count < pixel_count ? packet_count : pixel_count;
+            packet_count -= count;
+            pixel_count -= count;
+        }
+    }
+    if (position > decoding->size) {
+        return TGA_ERROR_FILE_CANNOT_READ;
+    }
+    return TGA_NO_ERROR;
+}
+
+// Decodes a band of scanlines, is executed by run_parallel().
+static void decode_band(void *arg, int band) {
+    struct parallel_decoding *decoding = (struct parallel_decoding *)arg;
+    const tga_info *info = decoding->info;
+    const struct scanline_position *band_position =
+        &decoding->band_positions[band];
+    if (band_position->offset > decoding->size) {
+        decoding->band_error_codes[band] = TGA_ERROR_FILE_CANNOT_READ;
+        return;
+    }
+    struct data_source source;
+    init_memory_source(&source, decoding->buffer, decoding->size);
+    source.position = band_position->offset;
+    struct decoder decoder;
+    init_decoder(&decoder, decoding->header, info->width,
+                 decoding->decoded_format, decoding->map, &source);
+    struct row_converter converter;
+    if (init_row_converter(&converter, info, info->width,
+                           decoding->decoded_format, decoding->options)) {
+        decoding->band_error_codes[band] = TGA_ERROR_OUT_OF_MEMORY;
+        return;
+    }
+
+    enum tga_error error_code = TGA_NO_ERROR;
+    if (band_position->skip_count > 0) {
+        // Resumes the packet which has been started by the previous band.
+        error_code = read_packet_header(&decoder);
+        if (error_code == TGA_NO_ERROR && !decoder.is_run_length_packet &&
+            skip_bytes(&source, (size_t)band_position->skip_count *
+                                    decoder.pixel_size)) {
+            error_code = TGA_ERROR_FILE_CANNOT_READ;
+        }
+        decoder.packet_count -= band_position->skip_count;
+    }
+
+    bool flip_v = !(decoding->header->image_descriptor & 0x20);
+    int first_row = band * decoding->band_rows;
+    int last_row = first_row + decoding->band_rows;
+    if (last_row > info->height) {
+        last_row = info->height;
+    }
+    for (int i = first_row; i < last_row && error_code == TGA_NO_ERROR; ++i) {
+        int y = flip_v ? info->height - 1 - i : i;
+        error_code = decode_converted_scanline(
+            decoding->data + decoding->stride * y, &decoder, &converter);
+    }
+    free_row_converter(&converter);
+    decoding->band_error_codes[band] = error_code;
+}
+
+// Decodes the image data from a memory source with multiple threads.
+static enum tga_error decode_image_parallel(
+    uint8_t *data, size_t stride, const tga_info *info,
+    enum tga_pixel_format decoded_format, const struct tga_header *header,
+    const struct color_map *map, const struct data_source *source,
+    const struct tga_load_options *options) {
+    int thread_count = clamp_thread_count(options->thread_count);
+    struct parallel_decoding decoding;
+    decoding.data = data;
+    decoding.stride = stride;
+    decoding.info = info;
+    decoding.decoded_format = decoded_format;
+    decoding.options = options;
+    decoding.header = header;
+    decoding.map = map;
+    decoding.buffer = source->buffer;
+    decoding.size = source->size;
+    // Several bands per thread, so that the threads stay busy when the bands
+    // take different time.
+    decoding.band_rows = info->height / (thread_count * 4);
+    if (decoding.band_rows < MIN_BAND_ROWS) {
+        decoding.band_rows = MIN_BAND_ROWS;
+    }
+    int band_count =
+        (info->height + decoding.band_rows - 1) / decoding.band_rows;
+    if (!IS_RLE(*header)) {
+        // The bands of the uncompressed image are found by their offsets, so
+        // the truncated data must be rejected before decoding.
+        size_t row_size =
+            (size_t)info->width * BITS_TO_BYTES(header->pixel_depth);
+        if (source->position > decoding.size ||
+            row_size * info->height > decoding.size - source->position) {
+            return TGA_ERROR_FILE_CANNOT_READ;
+        }
+    }
+    // The small band arrays are freed right after the decoding, they do not
+    // use the allocator of the image, which may never release memory.
+    decoding.band_positions = (struct scanline_position *)malloc(
+        sizeof(struct scanline_position) * band_count);
+    decoding.band_error_codes =
+        (enum tga_error *)malloc(sizeof(enum tga_error) * band_count);
+    if (decoding.band_positions == NULL || decoding.band_error_codes == NULL) {
+        free(decoding.band_positions);
+        free(decoding.band_error_codes);
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+
+    enum tga_error error_code = TGA_NO_ERROR;
+    if (IS_RLE(*header)) {
+        error_code = index_rle_scanlines(&decoding, source->position);
+    } else {
+        // The scanlines of the uncompressed image have a fixed size.
+        size_t row_size =
+            (size_t)info->width * BITS_TO_BYTES(header->pixel_depth);
+        for (int i = 0; i < band_count; ++i) {
+            decoding.band_positions[i].offset =
+                source->position + row_size * decoding.band_rows * i;
+            decoding.band_positions[i].skip_count = 0;
+        }
+    }
+    if (error_code == TGA_NO_ERROR) {
+        run_parallel(decode_band, &decoding, band_count, thread_count);
+        // Reports the error of the first failed band, as the serial decoding
+        // does.
+        for (int i = 0; i < band_count; ++i) {
+            if (decoding.band_error_codes[i] != TGA_NO_ERROR) {
+                error_code = decoding.band_error_codes[i];
+                break;
+            }
+        }
+    }
+    free(decoding.band_positions);
+    free(decoding.band_error_codes);
+    return error_code;
+}
+
+// Checks if the image fits in the destination.
+// Returns false means no error, otherwise returns true.
+static bool check_destination(const struct tga_destination *destination,
+                              int width, int height, int pixel_size) {
+    return destination->data == NULL || destination->x < 0 ||
+           destination->y < 0 || width > destination->width - destination->x ||
+           height > destination->height - destination->y ||
+           destination->stride < (size_t)destination->width * pixel_size;
+}
+
+// Decodes the image data from the source, the rows of data are stride bytes
+// apart. Each scanline is decoded directly to its final row, to keep the origin
+// in upper left corner. The pixels are converted from the decoded format to
+// the format of the info on the way.
+static enum tga_error decode_image(uint8_t *data, size_t stride,
+                                   const tga_info *info,
+                                   enum tga_pixel_format decoded_format,
+                                   const struct tga_header *header,
+                                   const struct color_map *map,
+                                   struct data_source *source,
+                                   const struct tga_load_options *options) {
+    int thread_count = options != NULL ? options->thread_count : 0;
+    if (thread_count > 1 && source->file == NULL &&
+        info->height >= MIN_BAND_ROWS * 2) {
+        return decode_image_parallel(data, stride, info, decoded_format, header,
+                                     map, source, options);
+    }
+    struct decoder decoder;
+    init_decoder(&decoder, header, info->width, decoded_format, map, source);
+    struct row_converter converter;
+    if (init_row_converter(&converter, info, info->width, decoded_format,
+                           options)) {
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    bool flip_v = !(header->image_descriptor & 0x20);
+    enum tga_error error_code = TGA_NO_ERROR;
+    for (int i = 0; i < info->height && error_code == TGA_NO_ERROR; ++i) {
+        int y = flip_v ? info->height - 1 - i : i;
+        error_code =
+            decode_converted_scanline(data + stride * y, &decoder, &converter);
+    }
+    free_row_converter(&converter);
+    return error_code;
+}
+
+// Skips `count` pixels of the image data without decoding them, the pixels may
+// span several scanlines. Only the headers of the RLE packets are read.
+static enum tga_error skip_pixels(struct decoder *decoder, size_t count) {
+    if (!decoder->is_rle) {
+        if (skip_bytes(decoder->source, count * decoder->pixel_size)) {
+            return TGA_ERROR_FILE_CANNOT_READ;
+        }
+        return TGA_NO_ERROR;
+    }
+    while (count > 0) {
+        if (decoder->packet_count == 0) {
+            enum tga_error error_code = read_packet_header(decoder);
+            if (error_code != TGA_NO_ERROR) {
+                return error_code;
+            }
+        }
+        int skipped = (size_t)decoder->packet_count < count
+                          ? decoder->packet_count
+                          : (int)count;
+        // The pixel of a run length packet has been read with its header.
+        if (!decoder->is_run_length_packet &&
+            skip_bytes(decoder->source,
+                       (size_t)skipped * decoder->pixel_size)) {
+            return TGA_ERROR_FILE_CANNOT_READ;
+        }
+        decoder->packet_count -= skipped;
+        count -= skipped;
+    }
+    return TGA_NO_ERROR;
+}
+
+// Reads the scanlines of a region of the image in the order of the file. The
+// scanlines above the region are skipped, and the source is not read after the
+// last scanline of the region. The decoder only outputs the columns of the
+// region, the other columns are skipped.
+struct region_reader {
+    struct decoder decoder;
+    const struct image_region *region;
+    // Number of pixels from the end of a scanline of the region to the
+    // beginning of the next one.
+    size_t row_gap;
+    bool flip_v;
+    // Number of scanlines that have been read.
+    int row_count;
+};
+
+// Prepares the reader and skips the pixels before the region.
+static enum tga_error init_region_reader(struct region_reader *reader,
+                                         const struct tga_header *header,
+                                         const struct image_region *region,
+                                         enum tga_pixel_format decoded_format,
+                                         const struct color_map *map,
+                                         struct data_source *source) {
+    init_decoder(&reader->decoder, header, region->width, decoded_format, map,
+                 source);
+    reader->region = region;
+    reader->row_gap = (size_t)(header->image_width - region->width);
+    reader->flip_v = !(header->image_descriptor & 0x20);
+    reader->row_count = 0;
+    // Finds the first pixel of the region in the order of the file.
+    int first_column = reader->decoder.flip_h
+                           ? header->image_width - region->x - region->width
+                           : region->x;
+    int first_row = reader->flip_v
+                        ? header->image_height - region->y - region->height
+                        : region->y;
+    return skip_pixels(&reader->decoder,
+                       (size_t)first_row * header->image_width + first_column);
+}
+
+// Gets the row in the region of the next scanline to be read.
+static inline int get_next_region_row(const struct region_reader *reader) {
+    return reader->flip_v ? reader->region->height - 1 - reader->row_count
+                          : reader->row_count;
+}
+
+// Decodes the next scanline of the region to `row`.
+static enum tga_error read_region_row(struct region_reader *reader,
+                                      uint8_t *row,
+                                      const struct row_converter *converter) {
+    if (reader->row_count > 0) {
+        // The columns on the right of the region, and the columns on the left
+        // of it in the next scanline.
+        enum tga_error error_code =
+            skip_pixels(&reader->decoder, reader->row_gap);
+        if (error_code != TGA_NO_ERROR) {
+            return error_code;
+        }
+    }
+    reader->row_count++;
+    return decode_converted_scanline(row, &reader->decoder, converter);
+}
+
+// Decodes a region of the image, the info has the size of the region.
+static enum tga_error decode_region(uint8_t *data, size_t stride,
+                                    const tga_info *info,
+                                    enum tga_pixel_format decoded_format,
+                                    const struct tga_header *header,
+                                    const struct image_region *region,
+                                    const struct color_map *map,
+                                    struct data_source *source,
+                                    const struct tga_load_options *options) {
+    struct row_converter converter;
+    if (init_row_converter(&converter, info, region->width, decoded_format,
+                           options)) {
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    struct region_reader reader;
+    enum tga_error error_code = init_region_reader(
+        &reader, header, region, decoded_format, map, source);
+    for (int i = 0; i < region->height && error_code == TGA_NO_ERROR; ++i) {
+        int y = get_next_region_row(&reader);
+        error_code = read_region_row(&reader, data + stride * y, &converter);
+    }
+    free_row_converter(&converter);
+    return error_code;
+}
+
+// Gets the number of channels averaged by the box filter, -1 if the pixels
+// cannot be averaged. The attribute bit of TGA_PIXEL_RGB555 is averaged as a
+// channel too.
+static int get_channel_count(enum tga_pixel_format format) {
+    switch (format) {
+        case TGA_PIXEL_BW8:
+        case TGA_PIXEL_BW16:
+            return 1;
+        case TGA_PIXEL_RGB24:
+            return 3;
+        case TGA_PIXEL_RGB555:
+        case TGA_PIXEL_ARGB32:
+        case TGA_PIXEL_ABGR32:
+        case TGA_PIXEL_ARGB64:
+            return 4;
+        default:
+            return -1;
+    }
+}
+
+// Reduces an image by 1 << shift, each pixel of the reduced image is the
+// average of a box of pixels. The boxes on the right and bottom edges are
+// smaller if the size of the image is not a multiple of the box size. The
+// rows of the image can be added in either direction.
+struct box_filter {
+    enum tga_pixel_format format;
+    int shift;
+    int source_width;
+    int source_height;
+    int width;
+    int height;
+    int channel_count;
+    // The channel sums of the boxes of the current row of boxes.
+    uint32_t *sums;
+    // Number of rows added to the current row of boxes.
+    int row_count;
+};
+
+// Gets the size reduced by 1 << shift, rounded up.
+#define REDUCE_SIZE(size, shift) ((((size)-1) >> (shift)) + 1)
+
+// The sums are allocated by calloc(), they are released when the decoding ends.
+// Returns false means no error, otherwise returns true (out of memory).
+static bool init_box_filter(struct box_filter *filter,
+                            enum tga_pixel_format format, int shift,
+                            int source_width, int source_height) {
+    filter->format = format;
+    filter->shift = shift;
+    filter->source_width = source_width;
+    filter->source_height = source_height;
+    filter->width = REDUCE_SIZE(source_width, shift);
+    filter->height = REDUCE_SIZE(source_height, shift);
+    filter->channel_count = get_channel_count(format);
+    filter->row_count = 0;
+    filter->sums = (uint32_t *)calloc(
+        (size_t)filter->width * filter->channel_count, sizeof(uint32_t));
+    return filter->sums == NULL;
+}
+
+// Adds the channels of a row of the source image to the sums.
+static void add_row_to_sums(struct box_filter *filter, const uint8_t *row) {
+    int shift = filter->shift;
+    int channel_count = filter->channel_count;
+    switch (filter->format) {
+        case TGA_PIXEL_BW8:
+        case TGA_PIXEL_RGB24:
+        case TGA_PIXEL_ARGB32:
+        case TGA_PIXEL_ABGR32:
+            for (int x = 0; x < filter->source_width; ++x) {
+                uint32_t *sums = filter->sums + (x >> shift) * channel_count;
+                const uint8_t *p = row + x * channel_count;
+                for (int c = 0; c < channel_count; ++c) {
+                    sums[c] += p[c];
+                }
+            }
+            break;
+        case TGA_PIXEL_BW16:
+        case TGA_PIXEL_ARGB64:
+            for (int x = 0; x < filter->source_width; ++x) {
+                uint32_t *sums = filter->sums + (x >> shift) * channel_count;
+                const uint8_t *p = row + x * channel_count * 2;
+                for (int c = 0; c < channel_count; ++c) {
+                    sums[c] += p[c * 2] | p[c * 2 + 1] << 8;
+                }
+            }
+            break;
+        case TGA_PIXEL_RGB555:
+            for (int x = 0; x < filter->source_width; ++x) {
+                uint32_t *sums = filter->sums + (x >> shift) * 4;
+                uint32_t value = row[x * 2] | row[x * 2 + 1] << 8;
+                sums[0] += value & 0x1F;
+                sums[1] += (value >> 5) & 0x1F;
+                sums[2] += (value >> 10) & 0x1F;
+                sums[3] += value >> 15;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Stores the averages of the boxes to a row of the reduced image, the boxes
+// have `box_rows` rows.
+static void store_averages(uint8_t *row, const struct box_filter *filter,
+                           int box_rows) {
+    int box_size = 1 << filter->shift;
+    int channel_count = filter->channel_count;
+    for (int x = 0; x < filter->width; ++x) {
+        int box_columns = filter->source_width - (x << filter->shift);
+        if (box_columns > box_size) {
+            box_columns = box_size;
+        }
+        uint32_t divisor = (uint32_t)(box_columns * box_rows);
+        const uint32_t *sums = filter->sums + x * channel_count;
+        uint32_t averages[4];
+        for (int c = 0; c < channel_count; ++c) {
+            // Rounded to nearest.
+            averages[c] = (sums[c] + divisor / 2) / divisor;
+        }
+        switch (filter->format) {
+            case TGA_PIXEL_BW8:
+            case TGA_PIXEL_RGB24:
+            case TGA_PIXEL_ARGB32:
+            case TGA_PIXEL_ABGR32:
+                for (int c = 0; c < channel_count; ++c) {
+                    row[x * channel_count + c] = (uint8_t)averages[c];
+                }
+                break;
+            case TGA_PIXEL_BW16:
+            case TGA_PIXEL_ARGB64:
+                for (int c = 0; c < channel_count; ++c) {
+                    uint8_t *p = row + (x * channel_count + c) * 2;
+                    p[0] = averages[c] & 0xFF;
+                    p[1] = (uint8_t)(averages[c] >> 8);
+                }
+                break;
+            case TGA_PIXEL_RGB555: {
+                uint32_t value = averages[0] | averages[1] << 5 |
+                                 averages[2] << 10 | averages[3] << 15;
+                row[x * 2] = value & 0xFF;
+                row[x * 2 + 1] = (uint8_t)(value >> 8);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+// Adds the row y of the source image. When the row completes a row of boxes,
+// stores the averages to the reduced image in data and returns the stored row,
+// otherwise returns null.
+static uint8_t *box_filter_add_row(struct box_filter *filter,
+                                   const uint8_t *row, int y, uint8_t *data,
+                                   size_t stride) {
+    add_row_to_sums(filter, row);
+    int box_y = y >> filter->shift;
+    int box_rows = filter->source_height - (box_y << filter->shift);
+    if (box_rows > 1 << filter->shift) {
+        box_rows = 1 << filter->shift;
+    }
+    if (++filter->row_count < box_rows) {
+        return NULL;
+    }
+    uint8_t *reduced_row = data + stride * box_y;
+    store_averages(reduced_row, filter, box_rows);
+    memset(filter->sums, 0,
+           sizeof(uint32_t) * filter->width * filter->channel_count);
+    filter->row_count = 0;
+    return reduced_row;
+}
+
+// Decodes a region of the image to a chain of images in a single pass over the
+// scanlines. The first image is the region reduced by 1 << shift, each of the
+// next images is half the size of the previous one. The info is the one of the
+// first image.
+static enum tga_error decode_chain(uint8_t *const *level_data,
+                                   const size_t *level_strides,
+                                   int level_count, int shift,
+                                   const tga_info *info,
+                                   enum tga_pixel_format decoded_format,
+                                   const struct tga_header *header,
+                                   const struct image_region *region,
+                                   const struct color_map *map,
+                                   struct data_source *source,
+                                   const struct tga_load_options *options) {
+    // filters[0] reduces the region if shift is not 0, filters[k] reduces the
+    // level k - 1 to the level k.
+    struct box_filter filters[TGA_MAX_MIP_LEVEL_COUNT];
+    for (int k = 0; k < level_count; ++k) {
+        filters[k].sums = NULL;
+    }
+    // Holds the scanline of the region if the first level is reduced. Like the
+    // sums of the filters, it is scratch memory allocated by malloc().
+    uint8_t *row = NULL;
+    struct row_converter converter;
+    converter.row = NULL;
+
+    enum tga_error error_code = TGA_NO_ERROR;
+    int source_width = region->width;
+    int source_height = region->height;
+    for (int k = shift > 0 ? 0 : 1; k < level_count; ++k) {
+        if (init_box_filter(&filters[k], info->pixel_format,
+                            k == 0 ? shift : 1, source_width, source_height)) {
+            error_code = TGA_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        source_width = filters[k].width;
+        source_height = filters[k].height;
+    }
+    if (error_code == TGA_NO_ERROR && shift > 0) {
+        row = (uint8_t *)malloc((size_t)region->width *
+                                pixel_format_to_pixel_size(info->pixel_format));
+        if (row == NULL) {
+            error_code = TGA_ERROR_OUT_OF_MEMORY;
+        }
+    }
+    if (error_code == TGA_NO_ERROR &&
+        init_row_converter(&converter, info, region->width, decoded_format,
+                           options)) {
+        error_code = TGA_ERROR_OUT_OF_MEMORY;
+    }
+
+    struct region_reader reader;
+    if (error_code == TGA_NO_ERROR) {
+        error_code = init_region_reader(&reader, header, region,
+                                        decoded_format, map, source);
+    }
+    for (int i = 0; i < region->height && error_code == TGA_NO_ERROR; ++i) {
+        int y = get_next_region_row(&reader);
+        uint8_t *level_row;
+        if (shift > 0) {
+            error_code = read_region_row(&reader, row, &converter);
+            level_row = box_filter_add_row(&filters[0], row, y, level_data[0],
+                                           level_strides[0]);
+            y >>= shift;
+        } else {
+            level_row = level_data[0] + level_strides[0] * y;
+            error_code = read_region_row(&reader, level_row, &converter);
+        }
+        // Passes each completed row down the chain.
+        for (int k = 1; k < level_count && level_row != NULL; ++k) {
+            level_row = box_filter_add_row(&filters[k], level_row, y,
+                                           level_data[k], level_strides[k]);
+            y >>= 1;
+        }
+    }
+
+    free_row_converter(&converter);
+    free(row);
+    for (int k = 0; k < level_count; ++k) {
+        free(filters[k].sums);
+    }
+    return error_code;
+}
+
+// Gets the shift of the scale of the options.
+// Returns false means no error, otherwise returns true (unsupported scale).
+static bool get_scale_shift(int *shift,
+                            const struct tga_load_options *options) {
+    int denominator = options != NULL ? options->scale_denominator : 0;
+    switch (denominator) {
+        case 0:
+        case 1:
+            *shift = 0;
+            return false;
+        case 2:
+            *shift = 1;
+            return false;
+        case 4:
+            *shift = 2;
+            return false;
+        case 8:
+            *shift = 3;
+            return false;
+        default:
+            return true;
+    }
+}
+
+// Loads the image from the source. The image data is decoded into the
+// destination if it is not null, otherwise into a new buffer returned by
+// data_out. Only the region is loaded if it is not null.
+static enum tga_error load_image(uint8_t **data_out, tga_info **info_out,
+                                 const struct tga_destination *destination,
+                                 const struct image_region *region,
+                                 struct data_source *source,
+                                 const struct tga_load_options *options) {
+    struct tga_header header;
+    enum tga_pixel_format pixel_format;
+    struct color_map color_map;
+    enum tga_error error_code = load_image_prologue(
+        &header, &pixel_format, &color_map, source, options);
+    if (error_code != TGA_NO_ERROR) {
+        return error_code;
+    }
+    struct image_region whole_image = {0, 0, header.image_width,
+                                       header.image_height};
+    bool is_whole_image = region == NULL ||
+                          (region->x == 0 && region->y == 0 &&
+                           region->width == header.image_width &&
+                           region->height == header.image_height);
+    if (region == NULL) {
+        region = &whole_image;
+    }
+
+    const struct tga_allocator *allocator =
+        options != NULL ? options->allocator : NULL;
+    if (region->x < 0 || region->y < 0 || region->width <= 0 ||
+        region->height <= 0 ||
+        region->width > header.image_width - region->x ||
+        region->height > header.image_height - region->y) {
+        deallocate(allocator, color_map.pixels);
+        return TGA_ERROR_INVALID_IMAGE_DIMENSIONS;
+    }
+    int shift;
+    if (get_scale_shift(&shift, options)) {
+        deallocate(allocator, color_map.pixels);
+        return TGA_ERROR_INVALID_IMAGE_DIMENSIONS;
+    }
+    enum tga_pixel_format image_format;
+    if (get_image_format(&image_format, pixel_format, options) ||
+        (shift > 0 && get_channel_count(image_format) == -1)) {
+        deallocate(allocator, color_map.pixels);
+        return TGA_ERROR_UNSUPPORTED_PIXEL_FORMAT;
+    }
+    int width = REDUCE_SIZE(region->width, shift);
+    int height = REDUCE_SIZE(region->height, shift);
+    int pixel_size = pixel_format_to_pixel_size(image_format);
+    uint8_t *data = NULL;
+    size_t stride = (size_t)width * pixel_size;
+    tga_info *info;
+    if (destination != NULL) {
+        if (check_destination(destination, width, height, pixel_size)) {
+            deallocate(allocator, color_map.pixels);
+            return TGA_ERROR_INVALID_IMAGE_DIMENSIONS;
+        }
+        info = create_info(width, height, image_format, allocator);
+        if (info == NULL) {
+            deallocate(allocator, color_map.pixels);
+            return TGA_ERROR_OUT_OF_MEMORY;
+        }
+        stride = destination->stride;
+    } else {
+        // The decoder writes every pixel, so the data is not zeroed first.
+        error_code = create_image(&data, &info, width, height, image_format,
+                                  allocator, false);
+        if (error_code != TGA_NO_ERROR) {
+            deallocate(allocator, color_map.pixels);
+            return error_code;
+        }
+    }
+    attach_color_map(info, &color_map);
+
+    uint8_t *dest = data;
+    if (destination != NULL) {
+        dest = destination->data + destination->stride * destination->y +
+               (size_t)destination->x * pixel_size;
+    }
+    if (shift > 0) {
+        error_code =
+            decode_chain(&dest, &stride, 1, shift, info, pixel_format, &header,
+                         region, &color_map, source, options);
+    } else if (is_whole_image) {
+        error_code = decode_image(dest, stride, info, pixel_format, &header,
+                                  &color_map, source, options);
+    } else {
+        error_code = decode_region(dest, stride, info, pixel_format, &header,
+                                   region, &color_map, source, options);
+    }
+    deallocate(allocator, color_map.pixels);
+    if (error_code != TGA_NO_ERROR) {
+        tga_free_image(data, info);
+        return error_code;
+    }
+
+    if (data_out != NULL) {
+        *data_out = data;
+    }
+    *info_out = info;
+    return TGA_NO_ERROR;
+}
+
+// Loads the image from a file, see load_image().
+static enum tga_error load_file(uint8_t **data_out, tga_info **info_out,
+                                const struct tga_destination *destination,
+                                const struct image_region *region,
+                                const char *file_name,
+                                const struct tga_load_options *options) {
+#ifdef HAS_MMAP
+    if (options != NULL && options->thread_count > 1) {
+        // The parallel decoding needs random access to the image data, so
+        // decodes from the mapped file.
+        void *mapping;
+        size_t size;
+        if (!map_file(file_name, &mapping, &size)) {
+            struct data_source source;
+            init_memory_source(&source, mapping, size);
+            enum tga_error error_code =
+                load_image(data_out, info_out, destination, region, &source,
+                           options);
+            munmap(mapping, size);
+            return error_code;
+        }
+    }
+#endif
+    FILE *file = fopen(file_name, "rb");
+    if (file == NULL) {
+        return TGA_ERROR_FILE_CANNOT_READ;
+    }
+    struct data_source source;
+    init_file_source(&source, file);
+    enum tga_error error_code = load_image(data_out, info_out, destination,
+                                           region, &source, options);
+    fclose(file);
+    return error_code;
+}
+
+// Loads the image from the source as a chain of images, each one half the size
+// of the previous one down to 1x1, or until max_level_count images.
+static enum tga_error load_mip_chain(struct tga_mip_level *levels,
+                                     int max_level_count,
+                                     int *level_count_out,
+                                     struct data_source *source,
+                                     const struct tga_load_options *options) {
+    if (levels == NULL || level_count_out == NULL || max_level_count < 1) {
+        return TGA_ERROR_NO_DATA;
+    }
+    struct tga_header header;
+    enum tga_pixel_format pixel_format;
+    struct color_map color_map;
+    enum tga_error error_code = load_image_prologue(
+        &header, &pixel_format, &color_map, source, options);
+    if (error_code != TGA_NO_ERROR) {
+        return error_code;
+    }
+    const struct tga_allocator *allocator =
+        options != NULL ? options->allocator : NULL;
+    int shift;
+    if (get_scale_shift(&shift, options)) {
+        deallocate(allocator, color_map.pixels);
+        return TGA_ERROR_INVALID_IMAGE_DIMENSIONS;
+    }
+    enum tga_pixel_format image_format;
+    if (get_image_format(&image_format, pixel_format, options) ||
+        get_channel_count(image_format) == -1) {
+        deallocate(allocator, color_map.pixels);
+        return TGA_ERROR_UNSUPPORTED_PIXEL_FORMAT;
+    }
+
+    uint8_t *level_data[TGA_MAX_MIP_LEVEL_COUNT];
+    size_t level_strides[TGA_MAX_MIP_LEVEL_COUNT];
+    int pixel_size = pixel_format_to_pixel_size(image_format);
+    int width = REDUCE_SIZE(header.image_width, shift);
+    int height = REDUCE_SIZE(header.image_height, shift);
+    int level_count = 0;
+    while (level_count < max_level_count) {
+        error_code = create_image(&levels[level_count].data,
+                                  &levels[level_count].info, width, height,
+                                  image_format, allocator, false);
+        if (error_code != TGA_NO_ERROR) {
+            break;
+        }
+        level_data[level_count] = levels[level_count].data;
+        level_strides[level_count] = (size_t)width * pixel_size;
+        level_count++;
+        if (width == 1 && height == 1) {
+            break;
+        }
+        width = REDUCE_SIZE(width, 1);
+        height = REDUCE_SIZE(height, 1);
+    }
+    if (error_code == TGA_NO_ERROR) {
+        struct image_region whole_image = {0, 0, header.image_width,
+                                           header.image_height};
+        error_code = decode_chain(level_data, level_strides, level_count,
+                                  shift, levels[0].info, pixel_format, &header,
+                                  &whole_image, &color_map, source, options);
+    }
+    deallocate(allocator, color_map.pixels);
+    if (error_code != TGA_NO_ERROR) {
+        for (int k = 0; k < level_count; ++k) {
+            tga_free_image(levels[k].data, levels[k].info);
+        }
+        return error_code;
+    }
+    *level_count_out = level_count;
+    return TGA_NO_ERROR;
+}
+
+// Returns the info by info_out, or releases it if info_out is null.
+static void release_or_return_info(tga_info *info, tga_info **info_out) {
+    if (info_out != NULL) {
+        *info_out = info;
+    } else {
+        tga_free_info(info);
+    }
+}
+
+// A load submitted to a tga_loader. All fields after `loader` are protected by
+// the mutex of the loader once the request has been submitted.
+struct tga_load_request {
+    tga_loader *loader;
+    // Not null when loading from a file, owned by the request.
+    char *file_name;
+    const void *buffer;
+    size_t size;
+    struct tga_load_options options;
+    uint8_t *data;
+    tga_info *info;
+    enum tga_error error_code;
+    bool is_done;
+    // The next request in the queue of the loader.
+    tga_load_request *next;
+};
+
+struct tga_loader {
+#ifdef HAS_THREADS
+    pthread_mutex_t mutex;
+    // Signaled when a request is queued or the loader is stopping.
+    pthread_cond_t queue_cond;
+    // Signaled when a request is done.
+    pthread_cond_t done_cond;
+    tga_load_request *queue_head;
+    tga_load_request *queue_tail;
+    bool is_stopping;
+    pthread_t threads[MAX_THREAD_COUNT];
+#endif
+    // Zero if the requests are executed when submitted.
+    int thread_count;
+};
+
+// Loads the image of the request, the result is not yet published.
+static void execute_request(tga_load_request *request) {
+    if (request->file_name != NULL) {
+        request->error_code =
+            tga_load_with_options(&request->data, &request->info,
+                                  request->file_name, &request->options);
+    } else {
+        request->error_code = tga_load_from_memory_with_options(
+            &request->data, &request->info, request->buffer, request->size,
+            &request->options);
+    }
+}
+
+#ifdef HAS_THREADS
+
+// Executes the queued requests until the loader is stopping.
+static void *loader_worker(void *arg) {
+    tga_loader *loader = (tga_loader *)arg;
+    pthread_mutex_lock(&loader->mutex);
+    for (;;) {
+        while (loader->queue_head == NULL && !loader->is_stopping) {
+            pthread_cond_wait(&loader->queue_cond, &loader->mutex);
+        }
+        tga_load_request *request = loader->queue_head;
+        if (request == NULL) {
+            break;
+        }
+        loader->queue_head = request->next;
+        if (loader->queue_head == NULL) {
+            loader->queue_tail = NULL;
+        }
+        pthread_mutex_unlock(&loader->mutex);
+
+        // The request is not visible to other threads until it is done.
+        execute_request(request);
+
+        pthread_mutex_lock(&loader->mutex);
+        request->is_done = true;
+        pthread_cond_broadcast(&loader->done_cond);
+    }
+    pthread_mutex_unlock(&loader->mutex);
+    return NULL;
+}
+
+#endif  // HAS_THREADS
+
+enum tga_error tga_loader_create(tga_loader **loader_out, int thread_count) {
+    tga_loader *loader = (tga_loader *)calloc(1, sizeof(tga_loader));
+    if (loader == NULL) {
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+#ifdef HAS_THREADS
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+    if (thread_count > MAX_THREAD_COUNT) {
+        thread_count = MAX_THREAD_COUNT;
+    }
+    if (pthread_mutex_init(&loader->mutex, NULL) != 0) {
+        free(loader);
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    if (pthread_cond_init(&loader->queue_cond, NULL) != 0) {
+        pthread_mutex_destroy(&loader->mutex);
+        free(loader);
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    if (pthread_cond_init(&loader->done_cond, NULL) != 0) {
+        pthread_cond_destroy(&loader->queue_cond);
+        pthread_mutex_destroy(&loader->mutex);
+        free(loader);
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    for (int i = 0; i < thread_count; ++i) {
+        if (pthread_create(&loader->threads[loader->thread_count], NULL,
+                           loader_worker, loader) == 0) {
+            ++loader->thread_count;
+        }
+    }
+    // Without any thread, the requests are executed when submitted.
+#else
+    (void)thread_count;
+#endif
+    *loader_out = loader;
+    return TGA_NO_ERROR;
+}
+
+// Queues the request, or executes it if the loader has no thread.
+static void submit_request(tga_loader *loader, tga_load_request *request) {
+    request->loader = loader;
+#ifdef HAS_THREADS
+    if (loader->thread_count > 0) {
+        pthread_mutex_lock(&loader->mutex);
+        if (loader->queue_tail != NULL) {
+            loader->queue_tail->next = request;
+        } else {
+            loader->queue_head = request;
+        }
+        loader->queue_tail = request;
+        pthread_cond_signal(&loader->queue_cond);
+        pthread_mutex_unlock(&loader->mutex);
+        return;
+    }
+#endif
+    execute_request(request);
+    request->is_done = true;
+}
+
+// Allocates a request with the copy of the options.
+static tga_load_request *create_request(
+    const struct tga_load_options *options) {
+    tga_load_request *request =
+        (tga_load_request *)calloc(1, sizeof(tga_load_request));
+    if (request != NULL && options != NULL) {
+        request->options = *options;
+    }
+    return request;
+}
+
+enum tga_error tga_loader_submit(tga_loader *loader,
+                                 tga_load_request **request_out,
+                                 const char *file_name,
+                                 const struct tga_load_options *options) {
+    tga_load_request *request = create_request(options);
+    if (request == NULL) {
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    // The caller does not have to keep the file name alive.
+    size_t name_size = strlen(file_name) + 1;
+    request->file_name = (char *)malloc(name_size);
+    if (request->file_name == NULL) {
+        free(request);
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    memcpy(request->file_name, file_name, name_size);
+    submit_request(loader, request);
+    *request_out = request;
+    return TGA_NO_ERROR;
+}
+
+enum tga_error tga_loader_submit_memory(
+    tga_loader *loader, tga_load_request **request_out, const void *buffer,
+    size_t size, const struct tga_load_options *options) {
+    if (buffer == NULL || size == 0) {
+        return TGA_ERROR_NO_DATA;
+    }
+    tga_load_request *request = create_request(options);
+    if (request == NULL) {
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    request->buffer = buffer;
+    request->size = size;
+    submit_request(loader, request);
+    *request_out = request;
+    return TGA_NO_ERROR;
+}
+
+int tga_load_poll(tga_load_request *request) {
+#ifdef HAS_THREADS
+    tga_loader *loader = request->loader;
+    if (loader->thread_count > 0) {
+        pthread_mutex_lock(&loader->mutex);
+        bool is_done = request->is_done;
+        pthread_mutex_unlock(&loader->mutex);
+        return is_done;
+    }
+#endif
+    return request->is_done;
+}
+
+enum tga_error tga_load_wait(tga_load_request *request, uint8_t **data_out,
+                             tga_info **info_out) {
+#ifdef HAS_THREADS
+    tga_loader *loader = request->loader;
+    if (loader->thread_count > 0) {
+        pthread_mutex_lock(&loader->mutex);
+        while (!request->is_done) {
+            pthread_cond_wait(&loader->done_cond, &loader->mutex);
+        }
+        pthread_mutex_unlock(&loader->mutex);
+    }
+#endif
+    enum tga_error error_code = request->error_code;
+    if (error_code == TGA_NO_ERROR) {
+        *data_out = request->data;
+        *info_out = request->info;
+    }
+    free(request->file_name);
+    free(request);
+    return error_code;
+}
+
+void tga_loader_destroy(tga_loader *loader) {
+    if (loader == NULL) {
+        return;
+    }
+#ifdef HAS_THREADS
+    if (loader->thread_count > 0) {
+        pthread_mutex_lock(&loader->mutex);
+        loader->is_stopping = true;
+        pthread_cond_broadcast(&loader->queue_cond);
+        pthread_mutex_unlock(&loader->mutex);
+        for (int i = 0; i < loader->thread_count; ++i) {
+            pthread_join(loader->threads[i], NULL);
+        }
+    }
+    pthread_cond_destroy(&loader->done_cond);
+    pthread_cond_destroy(&loader->queue_cond);
+    pthread_mutex_destroy(&loader->mutex);
+#endif
+    free(loader);
+}
+
+// Alignment of the blocks allocated from an arena.
+#define ARENA_ALIGNMENT 16
+
+struct tga_arena {
+#ifdef HAS_THREADS
+    // Protects `used`, so the arena can be shared by the threads of a batch.
+    pthread_mutex_t mutex;
+#endif
+    uint8_t *buffer;
+    size_t capacity;
+    size_t used;
+};
+
+// The alloc function of the arena allocator.
+static void *arena_alloc(void *user_data, size_t size) {
+    tga_arena *arena = (tga_arena *)user_data;
+    void *ptr = NULL;
+#ifdef HAS_THREADS
+    pthread_mutex_lock(&arena->mutex);
+#endif
+    size_t offset =
+        (arena->used + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (offset <= arena->capacity && size <= arena->capacity - offset) {
+        ptr = arena->buffer + offset;
+        arena->used = offset + size;
+    }
+#ifdef HAS_THREADS
+    pthread_mutex_unlock(&arena->mutex);
+#endif
+    return ptr;
+}
+
+// The release function of the arena allocator, the memory is only released by
+// tga_arena_reset().
+static void arena_release(void *user_data, void *ptr) {
+    (void)user_data;
+    (void)ptr;
+}
+
+enum tga_error tga_arena_create(tga_arena **arena_out, size_t capacity) {
+    tga_arena *arena = (tga_arena *)malloc(sizeof(tga_arena));
+    if (arena == NULL) {
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    // malloc() returns memory aligned for any type, which is enough for the
+    // ARENA_ALIGNMENT on the supported platforms.
+    arena->buffer = (uint8_t *)malloc(capacity > 0 ? capacity : 1);
+    if (arena->buffer == NULL) {
+        free(arena);
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+#ifdef HAS_THREADS
+    if (pthread_mutex_init(&arena->mutex, NULL) != 0) {
+        free(arena->buffer);
+        free(arena);
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+#endif
+    arena->capacity = capacity;
+    arena->used = 0;
+    *arena_out = arena;
+    return TGA_NO_ERROR;
+}
+
+void tga_arena_get_allocator(tga_arena *arena,
+                             struct tga_allocator *allocator_out) {
+    allocator_out->alloc = arena_alloc;
+    allocator_out->release = arena_release;
+    allocator_out->user_data = arena;
+}
+
+size_t tga_arena_get_used_size(tga_arena *arena) {
+#ifdef HAS_THREADS
+    pthread_mutex_lock(&arena->mutex);
+#endif
+    size_t used = arena->used;
+#ifdef HAS_THREADS
+    pthread_mutex_unlock(&arena->mutex);
+#endif
+    return used;
+}
+
+void tga_arena_reset(tga_arena *arena) {
+#ifdef HAS_THREADS
+    pthread_mutex_lock(&arena->mutex);
+#endif
+    arena->used = 0;
+#ifdef HAS_THREADS
+    pthread_mutex_unlock(&arena->mutex);
+#endif
+}
+
+void tga_arena_destroy(tga_arena *arena) {
+    if (arena == NULL) {
+        return;
+    }
+#ifdef HAS_THREADS
+    pthread_mutex_destroy(&arena->mutex);
+#endif
+    free(arena->buffer);
+    free(arena);
+}
+
+struct tga_reader {
+    // Not null if the reader opened the file.
+    FILE *file;
+    tga_info *info;
+    struct color_map color_map;
+    struct decoder decoder;
+    // Number of scanlines that have been read.
+    int row_count;
+    bool is_bottom_up;
+    // Allocates the info structure and the color map.
+    struct tga_allocator allocator;
+    struct row_converter converter;
+    struct data_source source;
+};
+
+// Prepares the reader to read the scanlines from its source.
+static enum tga_error open_reader(tga_reader *reader,
+                                  const struct tga_load_options *options) {
+    if (options != NULL && options->allocator != NULL) {
+        reader->allocator = *options->allocator;
+    }
+    struct tga_header header;
+    enum tga_pixel_format pixel_format;
+    enum tga_error error_code =
+        load_image_prologue(&header, &pixel_format, &reader->color_map,
+                            &reader->source, options);
+    if (error_code != TGA_NO_ERROR) {
+        return error_code;
+    }
+    enum tga_pixel_format image_format;
+    if (get_image_format(&image_format, pixel_format, options)) {
+        return TGA_ERROR_UNSUPPORTED_PIXEL_FORMAT;
+    }
+    reader->info = create_info(header.image_width, header.image_height,
+                               image_format, &reader->allocator);
+    if (reader->info == NULL) {
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    attach_color_map(reader->info, &reader->color_map);
+    init_decoder(&reader->decoder, &header, header.image_width, pixel_format,
+                 &reader->color_map, &reader->source);
+    if (init_row_converter(&reader->converter, reader->info,
+                           reader->info->width, pixel_format, options)) {
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    reader->is_bottom_up = !(header.image_descriptor & 0x20);
+    return TGA_NO_ERROR;
+}
+
+enum tga_error tga_reader_open(tga_reader **reader_out, const char *file_name,
+                               const struct tga_load_options *options) {
+    tga_reader *reader = (tga_reader *)calloc(1, sizeof(tga_reader));
+    if (reader == NULL) {
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    reader->file = fopen(file_name, "rb");
+    if (reader->file == NULL) {
+        free(reader);
+        return TGA_ERROR_FILE_CANNOT_READ;
+    }
+    init_file_source(&reader->source, reader->file);
+    enum tga_error error_code = open_reader(reader, options);
+    if (error_code != TGA_NO_ERROR) {
+        tga_reader_close(reader);
+        return error_code;
+    }
+    *reader_out = reader;
+    return TGA_NO_ERROR;
+}
+
+enum tga_error tga_reader_open_memory(tga_reader **reader_out,
+                                      const void *buffer, size_t size,
+                                      const struct tga_load_options *options) {
+    if (buffer == NULL || size == 0) {
+        return TGA_ERROR_NO_DATA;
+    }
+    tga_reader *reader = (tga_reader *)calloc(1, sizeof(tga_reader));
+    if (reader == NULL) {
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    init_memory_source(&reader->source, buffer, size);
+    enum tga_error error_code = open_reader(reader, options);
+    if (error_code != TGA_NO_ERROR) {
+        tga_reader_close(reader);
+        return error_code;
+    }
+    *reader_out = reader;
+    return TGA_NO_ERROR;
+}
+
+const tga_info *tga_reader_get_info(const tga_reader *reader) {
+    return reader->info;
+}
+
+int tga_reader_is_bottom_up(const tga_reader *reader) {
+    return reader->is_bottom_up;
+}
+
+int tga_reader_get_remaining_rows(const tga_reader *reader) {
+    return reader->info->height - reader->row_count;
+}
+
+enum tga_error tga_read_scanlines(tga_reader *reader, uint8_t *data,
+                                  int count) {
+    if (reader == NULL || data == NULL || count < 0 ||
+        count > tga_reader_get_remaining_rows(reader)) {
+        return TGA_ERROR_NO_DATA;
+    }
+    size_t row_size = (size_t)reader->info->width *
+                      pixel_format_to_pixel_size(reader->info->pixel_format);
+    for (int i = 0; i < count; ++i) {
+        enum tga_error error_code = decode_converted_scanline(
+            data + row_size * i, &reader->decoder, &reader->converter);
+        if (error_code != TGA_NO_ERROR) {
+            return error_code;
+        }
+        ++reader->row_count;
+    }
+    return TGA_NO_ERROR;
+}
+
+void tga_reader_close(tga_reader *reader) {
+    if (reader == NULL) {
+        return;
+    }
+    if (reader->file != NULL) {
+        fclose(reader->file);
+    }
+    deallocate(&reader->allocator, reader->color_map.pixels);
+    if (reader->info != NULL) {
+        free_row_converter(&reader->converter);
+    }
+    tga_free_info(reader->info);
+    free(reader);
+}
+
+// Returns the pixel at coordinates (x,y) for reading or writing.
 // If the pixel coordinates are out of bounds (larger than width/height
 // or small than 0), they will be clamped.
-static inline uint8_t *get_pixel(uint8_t *data, const tga_info *info, int x,
-                                 int y) {
+static inline uint8_t *get_pixel(uint8_t *data, size_t stride,
+                                 const tga_info *info, int x, int y) {
     if (x < 0) {
         x = 0;
     } else if (x >= info->width) {
@@ -593,38 +3727,605 @@ static inline uint8_t *get_pixel(uint8_t *data, const tga_info *info, int x,
         y = info->height - 1;
     }
     int pixel_size = pixel_format_to_pixel_size(info->pixel_format);
-    return data + (y * info->width + x) * pixel_size;
+    return data + stride * y + (size_t)x * pixel_size;
+}
+
+#ifdef HAS_SSE2
+
+// Reverses the order of the 16 bytes.
+static inline __m128i reverse_bytes_sse2(__m128i value) {
+    // Swaps the bytes in each 16-bit element, then reverses the elements.
+    value = _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+    value = _mm_shufflelo_epi16(value, _MM_SHUFFLE(0, 1, 2, 3));
+    value = _mm_shufflehi_epi16(value, _MM_SHUFFLE(0, 1, 2, 3));
+    return _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+// Reverses the order of the 16-bit elements.
+static inline __m128i reverse_uint16_sse2(__m128i value) {
+    value = _mm_shufflelo_epi16(value, _MM_SHUFFLE(0, 1, 2, 3));
+    value = _mm_shufflehi_epi16(value, _MM_SHUFFLE(0, 1, 2, 3));
+    return _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+// Reverses the order of the 32-bit elements.
+static inline __m128i reverse_uint32_sse2(__m128i value) {
+    return _mm_shuffle_epi32(value, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+// Reverses the row from both ends 16 bytes at a time, until the remaining
+// part is less than 32 bytes. Returns the number of pixels processed at each
+// end of the row.
+static int reverse_row_sse2(uint8_t *row, int width, int pixel_size) {
+    uint8_t *left = row;
+    uint8_t *right = row + (size_t)width * pixel_size;
+    while (right - left >= 32) {
+        right -= 16;
+        __m128i a = _mm_loadu_si128((const __m128i *)left);
+        __m128i b = _mm_loadu_si128((const __m128i *)right);
+        switch (pixel_size) {
+            case 1:
+                a = reverse_bytes_sse2(a);
+                b = reverse_bytes_sse2(b);
+                break;
+            case 2:
+                a = reverse_uint16_sse2(a);
+                b = reverse_uint16_sse2(b);
+                break;
+            case 4:
+                a = reverse_uint32_sse2(a);
+                b = reverse_uint32_sse2(b);
+                break;
+        }
+        _mm_storeu_si128((__m128i *)left, b);
+        _mm_storeu_si128((__m128i *)right, a);
+        left += 16;
+    }
+    return (int)((left - row) / pixel_size);
+}
+
+#endif  // HAS_SSE2
+
+// Reverses the order of the pixels in a row, is used to flip the image
+// horizontally.
+static void reverse_row(uint8_t *row, int width, int pixel_size) {
+    int i = 0;
+#ifdef HAS_SSE2
+    if (pixel_size != 3) {
+        i = reverse_row_sse2(row, width, pixel_size);
+    }
+#endif
+    int j = width - 1 - i;
+    switch (pixel_size) {
+        case 1:
+            for (; i < j; ++i, --j) {
+                uint8_t temp = row[i];
+                row[i] = row[j];
+                row[j] = temp;
+            }
+            break;
+        case 2:
+            for (; i < j; ++i, --j) {
+                uint16_t a, b;
+                memcpy(&a, row + i * 2, 2);
+                memcpy(&b, row + j * 2, 2);
+                memcpy(row + i * 2, &b, 2);
+                memcpy(row + j * 2, &a, 2);
+            }
+            break;
+        case 3:
+            for (; i < j; ++i, --j) {
+                uint8_t temp[3];
+                memcpy(temp, row + i * 3, 3);
+                memcpy(row + i * 3, row + j * 3, 3);
+                memcpy(row + j * 3, temp, 3);
+            }
+            break;
+        case 4:
+            for (; i < j; ++i, --j) {
+                uint32_t a, b;
+                memcpy(&a, row + i * 4, 4);
+                memcpy(&b, row + j * 4, 4);
+                memcpy(row + i * 4, &b, 4);
+                memcpy(row + j * 4, &a, 4);
+            }
+            break;
+    }
+}
+
+// Swaps the contents of two rows, is used to flip the image vertically.
+static void swap_rows(uint8_t *row1, uint8_t *row2, size_t row_size) {
+    // Swaps through a small buffer, so that the copies can use wide moves.
+    uint8_t temp[1024];
+    while (row_size > 0) {
+        size_t size = row_size < sizeof(temp) ? row_size : sizeof(temp);
+        memcpy(temp, row1, size);
+        memcpy(row1, row2, size);
+        memcpy(row2, temp, size);
+        row1 += size;
+        row2 += size;
+        row_size -= size;
+    }
+}
+
+// Default size of the buffer used to write data to the file stream in blocks.
+#define SINK_BUFFER_SIZE 16384
+
+// The encoder writes the TGA data through this structure, to avoid calling
+// fwrite() for every small RLE packet.
+struct data_sink {
+    FILE *file;
+    uint8_t *buffer;
+    size_t capacity;
+    size_t size;
+};
+
+// Returns false means no error, otherwise returns true (out of memory).
+static bool init_sink(struct data_sink *sink, FILE *file, size_t capacity) {
+    sink->file = file;
+    sink->capacity = capacity > 0 ? capacity : SINK_BUFFER_SIZE;
+    sink->size = 0;
+    sink->buffer = (uint8_t *)malloc(sink->capacity);
+    return sink->buffer == NULL;
+}
+
+// Writes the buffered bytes to the file stream.
+// Returns false means no error, otherwise returns true.
+static bool flush_sink(struct data_sink *sink) {
+    if (sink->size > 0 &&
+        fwrite(sink->buffer, 1, sink->size, sink->file) != sink->size) {
+        return true;
+    }
+    sink->size = 0;
+    return false;
+}
+
+// Writes `size` bytes from `src` to the sink.
+// Returns false means no error, otherwise returns true.
+static inline bool write_bytes(struct data_sink *sink, const void *src,
+                               size_t size) {
+    if (size <= sink->capacity - sink->size) {
+        memcpy(sink->buffer + sink->size, src, size);
+        sink->size += size;
+        return false;
+    }
+    if (flush_sink(sink)) {
+        return true;
+    }
+    if (size >= sink->capacity) {
+        // Large blocks are written directly without going through the buffer.
+        return fwrite(src, 1, size, sink->file) != size;
+    }
+    memcpy(sink->buffer, src, size);
+    sink->size = size;
+    return false;
+}
+
+// Checks whether two pixels are equal.
+static inline bool is_same_pixel(const uint8_t *p1, const uint8_t *p2,
+                                 int pixel_size) {
+    switch (pixel_size) {
+        case 1:
+            return p1[0] == p2[0];
+        case 2:
+            return p1[0] == p2[0] && p1[1] == p2[1];
+        default:
+            return memcmp(p1, p2, pixel_size) == 0;
+    }
+}
+
+#ifdef HAS_SSE2
+
+// Compares the 16 bytes at `p1` and `p2` in elements of `pixel_size` bytes.
+// Returns a bit mask with 1 for each equal byte of the equal elements.
+static inline int compare_pixels_sse2(const uint8_t *p1, const uint8_t *p2,
+                                      int pixel_size) {
+    __m128i a = _mm_loadu_si128((const __m128i *)p1);
+    __m128i b = _mm_loadu_si128((const __m128i *)p2);
+    __m128i result;
+    switch (pixel_size) {
+        case 1:
+            result = _mm_cmpeq_epi8(a, b);
+            break;
+        case 2:
+            result = _mm_cmpeq_epi16(a, b);
+            break;
+        default:
+            result = _mm_cmpeq_epi32(a, b);
+            break;
+    }
+    return _mm_movemask_epi8(result);
+}
+
+#endif  // HAS_SSE2
+
+// Counts the pixels from the beginning of `pixels` which are the same as the
+// first pixel, up to `max_count`.
+static int count_run_pixels(const uint8_t *pixels, int max_count,
+                            int pixel_size) {
+    int count = 1;
+#ifdef HAS_SSE2
+    if (pixel_size != 3) {
+        // Compares 16 bytes at a time with the previous pixels, all pixels in
+        // the block are the same as the first one if all bytes are equal.
+        int block_count = 16 / pixel_size;
+        while (count + block_count <= max_count &&
+               compare_pixels_sse2(pixels + count * pixel_size,
+                                   pixels + (count - 1) * pixel_size,
+                                   pixel_size) == 0xFFFF) {
+            count += block_count;
+        }
+    }
+#endif
+    while (count < max_count &&
+           is_same_pixel(pixels, pixels + count * pixel_size, pixel_size)) {
+        ++count;
+    }
+    return count;
+}
+
+// Counts the pixels from the beginning of `pixels` which should be stored in a
+// raw packet, that is, stops before two consecutive same pixels. Up to
+// `max_count`.
+static int count_raw_pixels(const uint8_t *pixels, int max_count,
+                            int pixel_size) {
+    int count = 0;
+#ifdef HAS_SSE2
+    if (pixel_size != 3) {
+        // Compares 16 bytes at a time with the next pixels, skips the block
+        // if no pixel is the same as the next one.
+        int block_count = 16 / pixel_size;
+        while (count + block_count + 1 <= max_count &&
+               compare_pixels_sse2(pixels + count * pixel_size,
+                                   pixels + (count + 1) * pixel_size,
+                                   pixel_size) == 0) {
+            count += block_count;
+        }
+    }
+#endif
+    while (count + 1 < max_count &&
+           !is_same_pixel(pixels + count * pixel_size,
+                          pixels + (count + 1) * pixel_size, pixel_size)) {
+        ++count;
+    }
+    if (count + 1 == max_count) {
+        // The last pixel has nothing to be compared with.
+        ++count;
+    }
+    return count;
+}
+
+// Encodes a scanline with run-length encoding. The packets never cross the
+// scanline, as the TGA 2.0 specification requires.
+// Returns false means no error, otherwise returns true.
+static bool encode_scanline_rle(struct data_sink *sink, const uint8_t *row,
+                                int width, int pixel_size) {
+    // The maximum number of pixels in a packet.
+    const int max_packet_count = 128;
+    while (width > 0) {
+        int max_count = width < max_packet_count ? width : max_packet_count;
+        int count = count_run_pixels(row, max_count, pixel_size);
+        uint8_t repetition_count_field;
+        size_t size;
+        if (count > 1) {
+            repetition_count_field = 0x80 | (count - 1);
+            size = pixel_size;
+        } else {
+            count = count_raw_pixels(row, max_count, pixel_size);
+            repetition_count_field = count - 1;
+            size = (size_t)count * pixel_size;
+        }
+        if (write_bytes(sink, &repetition_count_field, 1) ||
+            write_bytes(sink, row, size)) {
+            return true;
+        }
+        row += (size_t)count * pixel_size;
+        width -= count;
+    }
+    return false;
 }
 
-static enum tga_error save_image(const uint8_t *data, const tga_info *info,
-                                 FILE *file) {
+// Writes the header and the color map of the image.
+// Returns false means no error, otherwise returns true.
+static bool write_header(struct data_sink *sink, const tga_info *info,
+                         bool is_rle) {
     int pixel_size = pixel_format_to_pixel_size(info->pixel_format);
+    bool is_color_mapped = info->pixel_format == TGA_PIXEL_INDEX8;
     uint8_t header[HEADER_SIZE];
     memset(header, 0, HEADER_SIZE);
-    if (info->pixel_format == TGA_PIXEL_BW8 ||
-        info->pixel_format == TGA_PIXEL_BW16) {
-        header[2] = (uint8_t)TGA_TYPE_GRAYSCALE;
+    if (is_color_mapped) {
+        header[1] = 1;
+        header[2] = (uint8_t)(is_rle ? TGA_TYPE_RLE_COLOR_MAPPED
+                                     : TGA_TYPE_COLOR_MAPPED);
+        header[3] = info->map_first_index & 0xFF;
+        header[4] = (info->map_first_index >> 8) & 0xFF;
+        header[5] = info->map_length & 0xFF;
+        header[6] = (info->map_length >> 8) & 0xFF;
+        header[7] = info->map_entry_size * 8;
+    } else if (info->pixel_format == TGA_PIXEL_BW8 ||
+               info->pixel_format == TGA_PIXEL_BW16) {
+        header[2] =
+            (uint8_t)(is_rle ? TGA_TYPE_RLE_GRAYSCALE : TGA_TYPE_GRAYSCALE);
     } else {
-        header[2] = (uint8_t)TGA_TYPE_TRUE_COLOR;
+        header[2] =
+            (uint8_t)(is_rle ? TGA_TYPE_RLE_TRUE_COLOR : TGA_TYPE_TRUE_COLOR);
     }
     header[12] = info->width & 0xFF;
     header[13] = (info->width >> 8) & 0xFF;
     header[14] = info->height & 0xFF;
     header[15] = (info->height >> 8) & 0xFF;
     header[16] = pixel_size * 8;
-    if (info->pixel_format == TGA_PIXEL_ARGB32) {
+    if (info->pixel_format == TGA_PIXEL_ARGB32 ||
+        (is_color_mapped && info->map_entry_size == 4)) {
         header[17] = 0x28;
     } else {
         header[17] = 0x20;
     }
 
-    if (fwrite(header, 1, HEADER_SIZE, file) != HEADER_SIZE) {
-        return TGA_ERROR_FILE_CANNOT_WRITE;
+    if (write_bytes(sink, header, HEADER_SIZE)) {
+        return true;
+    }
+    if (is_color_mapped) {
+        size_t map_size = (size_t)info->map_length * info->map_entry_size;
+        if (write_bytes(sink, info->color_map, map_size)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+struct tga_writer {
+    FILE *file;
+    // Used to remove the file if the image is not saved completely.
+    char *file_name;
+    uint16_t width, height;
+    uint8_t pixel_size;
+    bool is_rle;
+    // Number of scanlines that have been written.
+    int row_count;
+    bool has_error;
+    struct data_sink sink;
+};
+
+enum tga_error tga_writer_open(tga_writer **writer_out, int width, int height,
+                               enum tga_pixel_format format,
+                               const char *file_name,
+                               const struct tga_save_options *options) {
+    if (check_dimensions(width, height)) {
+        return TGA_ERROR_INVALID_IMAGE_DIMENSIONS;
+    }
+    tga_info info = {width, height, format, NULL, 0, 0, 0, {NULL, NULL, NULL}};
+    return tga_writer_open_from_info(writer_out, &info, file_name, options);
+}
+
+enum tga_error tga_writer_open_from_info(
+    tga_writer **writer_out, const tga_info *info, const char *file_name,
+    const struct tga_save_options *options) {
+    if (info == NULL) {
+        return TGA_ERROR_NO_DATA;
+    }
+    int pixel_size = pixel_format_to_pixel_size(info->pixel_format);
+    // TGA files cannot store the formats that are only produced by the
+    // conversion.
+    if (pixel_size == -1 || info->pixel_format == TGA_PIXEL_ABGR32 ||
+        info->pixel_format == TGA_PIXEL_ARGB64) {
+        return TGA_ERROR_UNSUPPORTED_PIXEL_FORMAT;
+    }
+    if (info->pixel_format == TGA_PIXEL_INDEX8 && info->color_map == NULL) {
+        return TGA_ERROR_UNSUPPORTED_PIXEL_FORMAT;
+    }
+
+    tga_writer *writer = (tga_writer *)calloc(1, sizeof(tga_writer));
+    if (writer == NULL) {
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    writer->file_name = (char *)malloc(strlen(file_name) + 1);
+    size_t buffer_size = options != NULL ? options->buffer_size : 0;
+    if (writer->file_name == NULL ||
+        init_sink(&writer->sink, NULL, buffer_size)) {
+        free(writer->file_name);
+        free(writer->sink.buffer);
+        free(writer);
+        return TGA_ERROR_OUT_OF_MEMORY;
+    }
+    strcpy(writer->file_name, file_name);
+    writer->width = info->width;
+    writer->height = info->height;
+    writer->pixel_size = pixel_size;
+    writer->is_rle = options != NULL && (options->flags & TGA_SAVE_RLE);
+
+    // Check if a file with the same name already exists.
+    enum tga_error error_code = TGA_NO_ERROR;
+    FILE *file = fopen(file_name, "r");
+    if (file != NULL) {
+        fclose(file);
+        error_code = TGA_ERROR_FILE_CANNOT_WRITE;
+    } else {
+        writer->file = fopen(file_name, "wb");
+        writer->sink.file = writer->file;
+        if (writer->file == NULL) {
+            error_code = TGA_ERROR_FILE_CANNOT_WRITE;
+        } else if (write_header(&writer->sink, info, writer->is_rle)) {
+            writer->has_error = true;
+            error_code = TGA_ERROR_FILE_CANNOT_WRITE;
+        }
+    }
+    if (error_code != TGA_NO_ERROR) {
+        tga_writer_close(writer);
+        return error_code;
     }
+    *writer_out = writer;
+    return TGA_NO_ERROR;
+}
 
-    size_t data_size = (size_t)info->width * info->height * pixel_size;
-    if (fwrite(data, 1, data_size, file) != data_size) {
+enum tga_error tga_write_scanlines(tga_writer *writer, const uint8_t *data,
+                                   int count) {
+    if (writer == NULL || data == NULL || count < 0 ||
+        count > writer->height - writer->row_count) {
+        return TGA_ERROR_NO_DATA;
+    }
+    if (writer->has_error) {
+        return TGA_ERROR_FILE_CANNOT_WRITE;
+    }
+    size_t row_size = (size_t)writer->width * writer->pixel_size;
+    if (writer->is_rle) {
+        for (int i = 0; i < count; ++i) {
+            if (encode_scanline_rle(&writer->sink, data + row_size * i,
+                                    writer->width, writer->pixel_size)) {
+                writer->has_error = true;
+                return TGA_ERROR_FILE_CANNOT_WRITE;
+            }
+        }
+    } else if (write_bytes(&writer->sink, data, row_size * count)) {
+        writer->has_error = true;
         return TGA_ERROR_FILE_CANNOT_WRITE;
     }
+    writer->row_count += count;
+    return TGA_NO_ERROR;
+}
+
+enum tga_error tga_writer_close(tga_writer *writer) {
+    if (writer == NULL) {
+        return TGA_NO_ERROR;
+    }
+    enum tga_error error_code = TGA_NO_ERROR;
+    if (writer->file != NULL) {
+        if (writer->has_error || flush_sink(&writer->sink)) {
+            error_code = TGA_ERROR_FILE_CANNOT_WRITE;
+        } else if (writer->row_count != writer->height) {
+            error_code = TGA_ERROR_NO_DATA;
+        }
+        if (fclose(writer->file) != 0 && error_code == TGA_NO_ERROR) {
+            error_code = TGA_ERROR_FILE_CANNOT_WRITE;
+        }
+        if (error_code != TGA_NO_ERROR) {
+            remove(writer->file_name);
+        }
+    }
+    free(writer->sink.buffer);
+    free(writer->file_name);
+    free(writer);
+    return error_code;
+}
+
+// Uses the decoded image when the file data cannot be used in place.
+static void use_decoded_image(tga_mapped_image *image, uint8_t *data,
+                              tga_info *info) {
+    image->info = *info;
+    image->data = data;
+    image->stride =
+        info->width * pixel_format_to_pixel_size(info->pixel_format);
+    image->decoded_data = data;
+    image->decoded_info = info;
+}
+
+#ifdef HAS_MMAP
+
+// Maps the whole file into memory for reading.
+// Returns false means no error, otherwise returns true.
+static bool map_file(const char *file_name, void **mapping_out,
+                     size_t *size_out) {
+    int fd = open(file_name, O_RDONLY);
+    if (fd == -1) {
+        return true;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+        close(fd);
+        return true;
+    }
+    size_t file_size = (size_t)file_stat.st_size;
+    void *mapping = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the file descriptor is closed.
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return true;
+    }
+    *mapping_out = mapping;
+    *size_out = file_size;
+    return false;
+}
+
+static enum tga_error map_image(tga_mapped_image *image,
+                                const char *file_name) {
+    void *mapping;
+    size_t file_size;
+    if (map_file(file_name, &mapping, &file_size)) {
+        return TGA_ERROR_FILE_CANNOT_READ;
+    }
+    image->mapping = mapping;
+    image->mapping_size = file_size;
+
+    struct data_source source;
+    init_memory_source(&source, mapping, file_size);
+    struct tga_header header;
+    enum tga_pixel_format pixel_format;
+    enum tga_error error_code = load_header(&header, &pixel_format, &source);
+    if (error_code != TGA_NO_ERROR) {
+        return error_code;
+    }
+
+    // Only uncompressed images without color map and in left to right order
+    // can be used directly, the others need to be decoded.
+    bool flip_h = header.image_descriptor & 0x10;
+    if (IS_RLE(header) || IS_COLOR_MAPPED(header) || flip_h) {
+        uint8_t *data;
+        tga_info *info;
+        init_memory_source(&source, mapping, file_size);
+        error_code = load_image(&data, &info, NULL, NULL, &source, NULL);
+        if (error_code != TGA_NO_ERROR) {
+            return error_code;
+        }
+        use_decoded_image(image, data, info);
+        // The file data is no longer needed.
+        munmap(image->mapping, image->mapping_size);
+        image->mapping = NULL;
+        return TGA_NO_ERROR;
+    }
+
+    size_t data_offset = HEADER_SIZE + header.id_length;
+    if (header.map_type == 1) {
+        data_offset +=
+            header.map_length * BITS_TO_BYTES(header.map_entry_size);
+    }
+    int pixel_size = pixel_format_to_pixel_size(pixel_format);
+    int row_size = header.image_width * pixel_size;
+    size_t data_size = (size_t)row_size * header.image_height;
+    if (data_offset > file_size || data_size > file_size - data_offset) {
+        return TGA_ERROR_FILE_CANNOT_READ;
+    }
+
+    image->info.width = header.image_width;
+    image->info.height = header.image_height;
+    image->info.pixel_format = pixel_format;
+    const uint8_t *data = (const uint8_t *)mapping + data_offset;
+    bool flip_v = !(header.image_descriptor & 0x20);
+    if (flip_v) {
+        // The rows are stored from bottom to top, so starts from the last row
+        // and walks backwards.
+        image->data = data + data_size - row_size;
+        image->stride = -row_size;
+    } else {
+        image->data = data;
+        image->stride = row_size;
+    }
+    return TGA_NO_ERROR;
+}
+
+#else
+
+static enum tga_error map_image(tga_mapped_image *image,
+                                const char *file_name) {
+    // Memory mapping is not supported on this platform, decodes the image
+    // instead.
+    uint8_t *data;
+    tga_info *info;
+    enum tga_error error_code = tga_load(&data, &info, file_name);
+    if (error_code != TGA_NO_ERROR) {
+        return error_code;
+    }
+    use_decoded_image(image, data, info);
     return TGA_NO_ERROR;
 }
+
+#endif  // HAS_MMAP
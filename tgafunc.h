@@ -23,122 +23,1133 @@
 #ifndef TGAFUNC_H_
 #define TGAFUNC_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define TGA_MAX_IMAGE_DIMENSIONS 65535
 
+///
+/// \brief The number of levels of the mip chain of the largest image.
+///
+#define TGA_MAX_MIP_LEVEL_COUNT 17
+
 #ifdef __cplusplus
 extern "C" {
 #endif  // __cplusplus
 
 ///
-/// \brief Image pixel format.
+/// \brief Image pixel format.
+///
+/// The pixel data are all in little-endian. E.g. a TGA_PIXEL_ARGB32 format
+/// image, a single pixel is stored in the memory in the order of
+/// BBBBBBBB GGGGGGGG RRRRRRRR AAAAAAAA.
+///
+enum tga_pixel_format {
+    ///
+    /// \brief Single channel format represents grayscale, 8-bit integer.
+    ///
+    TGA_PIXEL_BW8,
+    ///
+    /// \brief Single channel format represents grayscale, 16-bit integer.
+    ///
+    TGA_PIXEL_BW16,
+    ///
+    /// \brief A 16-bit pixel format.
+    /// The topmost bit is assumed to an attribute bit, usually ignored.
+    /// Because of little-endian, this format pixel is stored in the memory in
+    /// the order of GGGBBBBB ARRRRRGG.
+    ///
+    TGA_PIXEL_RGB555,
+    ///
+    /// \brief RGB color format, 8-bit per channel.
+    ///
+    TGA_PIXEL_RGB24,
+    ///
+    /// \brief RGB color with alpha format, 8-bit per channel.
+    ///
+    TGA_PIXEL_ARGB32,
+    ///
+    /// \brief 8-bit index into the color map of the image.
+    /// The color map can be obtained by the tga_get_color_map() function.
+    ///
+    TGA_PIXEL_INDEX8,
+    ///
+    /// \brief RGB color with alpha format, 8-bit per channel, with the red and
+    /// blue channels swapped.
+    /// A single pixel is stored in the memory in the order of
+    /// RRRRRRRR GGGGGGGG BBBBBBBB AAAAAAAA, which is the RGBA8 layout expected
+    /// by most graphics APIs. TGA files cannot store this format, it is only
+    /// produced by the conversion.
+    ///
+    TGA_PIXEL_ABGR32,
+    ///
+    /// \brief RGB color with alpha format, 16-bit per channel.
+    /// Each channel is a little-endian 16-bit integer, stored in the order of
+    /// blue, green, red and alpha. Keeps the precision of the linear colors
+    /// produced by TGA_LOAD_LINEARIZE. TGA files cannot store this format, it
+    /// is only produced by the conversion.
+    ///
+    TGA_PIXEL_ARGB64
+};
+
+///
+/// \brief Error code list.
+///
+enum tga_error {
+    TGA_NO_ERROR = 0,
+    TGA_ERROR_OUT_OF_MEMORY,
+    TGA_ERROR_FILE_CANNOT_READ,
+    TGA_ERROR_FILE_CANNOT_WRITE,
+    TGA_ERROR_NO_DATA,
+    TGA_ERROR_UNSUPPORTED_COLOR_MAP_TYPE,
+    TGA_ERROR_UNSUPPORTED_IMAGE_TYPE,
+    TGA_ERROR_UNSUPPORTED_PIXEL_FORMAT,
+    TGA_ERROR_INVALID_IMAGE_DIMENSIONS,
+    TGA_ERROR_COLOR_MAP_INDEX_FAILED
+};
+
+///
+/// \brief Flags of the tga_load_options structure.
+///
+enum tga_load_flags {
+    ///
+    /// \brief Keeps the color mapped images indexed.
+    /// The pixel format of the loaded color mapped image is TGA_PIXEL_INDEX8,
+    /// the pixels are not expanded to the colors of the color map.
+    ///
+    TGA_LOAD_KEEP_COLOR_MAP = 1 << 0,
+    ///
+    /// \brief Converts the pixels to the pixel_format of the options.
+    /// Each scanline is converted right after it is decoded, while it is still
+    /// in the cache. TGA_PIXEL_INDEX8 cannot be converted to or from the other
+    /// formats, combine with TGA_LOAD_KEEP_COLOR_MAP to keep the indices.
+    ///
+    TGA_LOAD_CONVERT = 1 << 1,
+    ///
+    /// \brief Multiplies the color channels by the alpha channel.
+    /// The formats without alpha channel are not changed.
+    ///
+    TGA_LOAD_PREMULTIPLY = 1 << 2,
+    ///
+    /// \brief Decodes the sRGB colors to linear values.
+    /// Applied before TGA_LOAD_PREMULTIPLY, the alpha channel is not changed.
+    /// The 8-bit linear values lose precision in the dark colors, use
+    /// TGA_LOAD_CONVERT to TGA_PIXEL_ARGB64 to keep it. Not supported by the
+    /// TGA_PIXEL_BW16 and TGA_PIXEL_RGB555 formats.
+    ///
+    TGA_LOAD_LINEARIZE = 1 << 3
+};
+
+///
+/// \brief Memory allocation functions used for the image buffers.
+///
+/// A zero-initialized structure means malloc() and free(). The functions may
+/// be called from several threads at the same time when the image is decoded
+/// in parallel or loaded by a batch or a loader.
+///
+struct tga_allocator {
+    ///
+    /// \brief Returns a block of at least size bytes aligned for any type, or
+    /// a null pointer if out of memory.
+    ///
+    void *(*alloc)(void *user_data, size_t size);
+    ///
+    /// \brief Releases a block returned by alloc, can be a null pointer if
+    /// the memory is released in another way (e.g. by an arena).
+    ///
+    void (*release)(void *user_data, void *ptr);
+    ///
+    /// \brief Passed to the functions.
+    ///
+    void *user_data;
+};
+
+///
+/// \brief Options for loading an image.
+///
+/// Zero-initialize the structure to get the default behavior of tga_load(),
+/// then set the wanted fields.
+///
+struct tga_load_options {
+    ///
+    /// \brief Bitwise OR of the tga_load_flags values.
+    ///
+    unsigned int flags;
+    ///
+    /// \brief Maximum number of threads used to decode the image data, 0 or 1
+    /// means decoding on the calling thread only.
+    ///
+    /// The parallel decoding needs random access to the data, so it is used
+    /// when loading from memory, or from a file on platforms that support
+    /// memory mapping. RLE images are first scanned to find where each band of
+    /// scanlines starts, then the bands are decoded in parallel.
+    ///
+    int thread_count;
+    ///
+    /// \brief Allocates the image data, the info structure and the color map,
+    /// null means malloc() and free(). The allocator is copied into the info
+    /// structure, so the image must be released by tga_free_image(). The
+    /// scratch buffers that only live during the call, the band arrays of the
+    /// parallel decoding, the rows of the conversion and the sums of the
+    /// reduction, are always allocated by malloc().
+    ///
+    const struct tga_allocator *allocator;
+    ///
+    /// \brief Pixel format of the loaded image if TGA_LOAD_CONVERT is set.
+    ///
+    enum tga_pixel_format pixel_format;
+    ///
+    /// \brief Reduces the width and height of the loaded image by 2, 4 or 8,
+    /// 0 or 1 means the full size.
+    ///
+    /// Each pixel is the average of a box of pixels, the size is rounded up
+    /// and the boxes on the right and bottom edges are smaller. The scanlines
+    /// are reduced as they are decoded, so only the reduced image and a row of
+    /// box sums are allocated. The reduced image is decoded on the calling
+    /// thread, and the TGA_PIXEL_INDEX8 format cannot be reduced. Not used by
+    /// tga_reader_open().
+    ///
+    int scale_denominator;
+};
+
+///
+/// \brief Flags of the tga_save_options structure.
+///
+enum tga_save_flags {
+    ///
+    /// \brief Compresses the image data with run-length encoding.
+    ///
+    TGA_SAVE_RLE = 1 << 0
+};
+
+///
+/// \brief Options for saving an image.
+///
+/// Zero-initialize the structure to get the default behavior of
+/// tga_save_from_info(), then set the wanted fields.
+///
+struct tga_save_options {
+    ///
+    /// \brief Bitwise OR of the tga_save_flags values.
+    ///
+    unsigned int flags;
+    ///
+    /// \brief Byte size of the buffer used to write the file, 0 means the
+    /// default size (16 KiB).
+    ///
+    size_t buffer_size;
+};
+
+///
+/// \brief The header fields of a TGA file, filled by tga_probe().
+///
+struct tga_header_info {
+    ///
+    /// \brief The image width.
+    ///
+    int width;
+    ///
+    /// \brief The image height.
+    ///
+    int height;
+    ///
+    /// \brief The pixel format that tga_load() returns for the file.
+    ///
+    enum tga_pixel_format pixel_format;
+    ///
+    /// \brief The image type field, e.g. 2 for an uncompressed true-color
+    /// image.
+    ///
+    int image_type;
+    ///
+    /// \brief The number of bits per pixel stored in the file.
+    ///
+    int pixel_depth;
+    ///
+    /// \brief The number of attribute (alpha) bits per pixel.
+    ///
+    int alpha_bits;
+    ///
+    /// \brief Non-zero if the image data is run-length encoded.
+    ///
+    int is_rle;
+    ///
+    /// \brief Non-zero if the image data are color map indices.
+    ///
+    int is_color_mapped;
+    ///
+    /// \brief Non-zero if the file stores the bottom row first.
+    ///
+    int is_bottom_up;
+    ///
+    /// \brief Non-zero if the file stores the pixels of a row from right to
+    /// left.
+    ///
+    int is_right_to_left;
+    ///
+    /// \brief The X coordinate of the lower left corner of the image on the
+    /// screen.
+    ///
+    int x_origin;
+    ///
+    /// \brief The Y coordinate of the lower left corner of the image on the
+    /// screen.
+    ///
+    int y_origin;
+    ///
+    /// \brief The index of the first color map entry.
+    ///
+    int map_first_index;
+    ///
+    /// \brief The number of color map entries.
+    ///
+    int map_length;
+    ///
+    /// \brief The number of bits per color map entry.
+    ///
+    int map_entry_size;
+    ///
+    /// \brief The byte size of the image ID field.
+    ///
+    int id_length;
+    ///
+    /// \brief The image ID field, the bytes after id_length are zero.
+    ///
+    uint8_t id[255];
+};
+
+///
+/// \brief A caller-provided buffer that an image is decoded into by
+///        tga_load_into().
+///
+/// The buffer is width x height pixels of the loaded image's pixel format, its
+/// rows are stride bytes apart. The image is placed with its upper left corner
+/// at pixel (x,y) of the buffer and must fit in it.
+///
+struct tga_destination {
+    ///
+    /// \brief The first byte of the buffer.
+    ///
+    uint8_t *data;
+    ///
+    /// \brief Byte distance from one row of the buffer to the next.
+    ///
+    size_t stride;
+    ///
+    /// \brief The width of the buffer in pixels.
+    ///
+    int width;
+    ///
+    /// \brief The height of the buffer in pixels.
+    ///
+    int height;
+    ///
+    /// \brief The x coordinate of the image in the buffer.
+    ///
+    int x;
+    ///
+    /// \brief The y coordinate of the image in the buffer.
+    ///
+    int y;
+};
+
+///
+/// \brief Structure for saving image information.
+///
+typedef struct tga_info tga_info;
+
+///
+/// \brief Structure for an image mapped by tga_map().
+///
+typedef struct tga_mapped_image tga_mapped_image;
+
+///
+/// \brief Structure for reading an image scanline by scanline.
+///
+typedef struct tga_reader tga_reader;
+
+///
+/// \brief Structure for writing an image scanline by scanline.
+///
+typedef struct tga_writer tga_writer;
+
+///
+/// \brief Structure for a pool of threads that load images in the background.
+///
+typedef struct tga_loader tga_loader;
+
+///
+/// \brief Structure for a load submitted to a tga_loader.
+///
+typedef struct tga_load_request tga_load_request;
+
+///
+/// \brief Structure for a block of memory that the images are allocated from.
+///
+typedef struct tga_arena tga_arena;
+
+///
+/// \brief An image to be loaded by tga_load_batch().
+///
+struct tga_batch_item {
+    ///
+    /// \brief The TGA format file name to be loaded. If it is a null pointer,
+    /// the image is decoded from buffer instead.
+    ///
+    const char *file_name;
+    ///
+    /// \brief The TGA format data to be decoded if file_name is a null
+    /// pointer.
+    ///
+    const void *buffer;
+    ///
+    /// \brief The byte size of the buffer.
+    ///
+    size_t size;
+    ///
+    /// \brief Returns the image pixels data, null if the loading failed. Uses
+    /// tga_free_image() with info to release.
+    ///
+    uint8_t *data;
+    ///
+    /// \brief Returns the information of the image, null if the loading
+    /// failed. Uses tga_free_image() with data to release.
+    ///
+    tga_info *info;
+    ///
+    /// \brief Returns the result of loading the image.
+    ///
+    enum tga_error error_code;
+};
+
+///
+/// \brief Function called by tga_load_batch() when an item has been loaded.
+///
+/// The function may be called from several threads at the same time.
+///
+typedef void (*tga_batch_callback)(struct tga_batch_item *item,
+                                   void *user_data);
+
+///
+/// \brief Options for loading a batch of images.
+///
+/// Zero-initialize the structure to load the images one by one on the calling
+/// thread with the default options, then set the wanted fields.
+///
+struct tga_batch_options {
+    ///
+    /// \brief The options for loading each image, null means the default
+    /// options.
+    ///
+    const struct tga_load_options *load_options;
+    ///
+    /// \brief Maximum number of threads used to load the images, 0 or 1 means
+    /// loading on the calling thread only.
+    ///
+    int thread_count;
+    ///
+    /// \brief Called after each item is loaded, can be a null pointer.
+    ///
+    tga_batch_callback callback;
+    ///
+    /// \brief Passed to the callback.
+    ///
+    void *user_data;
+};
+
+///
+/// \brief Creates a empty image.
+///
+/// The coordinates of the image start from the upper left corner. Image pixel
+/// data is stored in a 1-dimensional array in a row major order.
+/// ```
+/// enum tga_error error_code;
+/// uint8_t *image_data;
+/// tga_info *image_info;
+/// error_code = tga_create(&image_data, &image_info, 128, 128,
+///                         TGA_PIXEL_RGB24);
+/// if (error_code == TGA_NO_ERROR) {
+///     // Use the created image...
+/// }
+/// ```
+///
+/// \param data_out Returns the image pixels data, all pixel values are set
+///                 to 0x0. Uses tga_free_data() to release.
+/// \param info_out Returns the information of the image. Uses tga_free_info()
+///                 to release.
+/// \param width The width of the image, the value cannot be less than 1 or
+///              greater than TGA_MAX_IMAGE_DIMENSISNS.
+/// \param height The height of the image. the value cannot be less than 1 or
+///               greater than TGA_MAX_IMAGE_DIMENSISNS.
+/// \param format Image pixel format.
+/// \return The result of the creation.
+///
+enum tga_error tga_create(uint8_t **data_out, tga_info **info_out, int width,
+                          int height, enum tga_pixel_format format);
+
+///
+/// \brief Creates a empty image with the specified allocator.
+///
+/// Same function as tga_create(), the image must be released by
+/// tga_free_image().
+///
+/// \param data_out Returns the image data.
+/// \param info_out Returns the image information.
+/// \param width The image width.
+/// \param height The image height.
+/// \param format The image pixel format.
+/// \param allocator The allocator of the image, null means malloc() and
+///                  free(). It is copied into the info structure.
+/// \return The result of creating the image.
+///
+enum tga_error tga_create_with_allocator(
+    uint8_t **data_out, tga_info **info_out, int width, int height,
+    enum tga_pixel_format format, const struct tga_allocator *allocator);
+
+///
+/// \brief Creates an image whose pixels are not initialized.
+///
+/// Same function as tga_create(), but the pixel values are undefined. Saves a
+/// pass over the memory when the caller writes every pixel anyway.
+///
+/// \param data_out Returns the image pixels data. Uses tga_free_data() to
+///                 release.
+/// \param info_out Returns the information of the image. Uses tga_free_info()
+///                 to release.
+/// \param width The width of the image.
+/// \param height The height of the image.
+/// \param format The pixel format of the image.
+/// \return The result of creating the image.
+///
+enum tga_error tga_create_uninitialized(uint8_t **data_out, tga_info **info_out,
+                                        int width, int height,
+                                        enum tga_pixel_format format);
+
+///
+/// \brief Loads image data and information from TGA format file.
+///
+/// The coordinates of the image start from the upper left corner. Image pixel
+/// data is stored in a 1-dimensional array in a row major order.
+/// ```
+/// enum tga_error error_code;
+/// uint8_t *image_data;
+/// tga_info *image_info;
+/// error_code = tga_load(&image_data, &image_info, file_name);
+/// if (error_code == TGA_NO_ERROR) {
+///     // Use the loaded image...
+/// }
+/// ```
+///
+/// \param data_out Returns the image pixels data. Uses tga_free_data() to
+///                 release.
+/// \param info_out Returns the information of the image. Uses tga_free_info()
+///                 to release.
+/// \param file_name The TGA format file name to be loaded.
+/// \return The result of loading the image.
+///
+enum tga_error tga_load(uint8_t **data_out, tga_info **info_out,
+                        const char *file_name);
+
+///
+/// \brief Loads image data and information from TGA format data in memory.
+///
+/// Same function as tga_load(), but decodes the TGA data from a memory buffer
+/// instead of a file. The buffer is only read during the call and can be
+/// released once the function returns.
+///
+/// If the buffer ends before the image is fully decoded, the function returns
+/// TGA_ERROR_FILE_CANNOT_READ. If buffer is a null pointer or size is 0, the
+/// function returns TGA_ERROR_NO_DATA.
+///
+/// \param data_out Returns the image pixels data. Uses tga_free_data() to
+///                 release.
+/// \param info_out Returns the information of the image. Uses tga_free_info()
+///                 to release.
+/// \param buffer The TGA format data to be decoded.
+/// \param size The byte size of the buffer.
+/// \return The result of loading the image.
+///
+enum tga_error tga_load_from_memory(uint8_t **data_out, tga_info **info_out,
+                                    const void *buffer, size_t size);
+
+///
+/// \brief Loads image data and information from TGA format file with the
+///        specified options.
+///
+/// Same function as tga_load(), if options is a null pointer, the default
+/// options are used.
+///
+/// \param data_out Returns the image pixels data.
+/// \param info_out Returns the information of the image. Uses
+///                 tga_free_image() to release both of them.
+/// \param file_name The TGA format file name to be loaded.
+/// \param options The options for loading the image.
+/// \return The result of loading the image.
+///
+enum tga_error tga_load_with_options(uint8_t **data_out, tga_info **info_out,
+                                     const char *file_name,
+                                     const struct tga_load_options *options);
+
+///
+/// \brief Loads image data and information from TGA format data in memory
+///        with the specified options.
+///
+/// Same function as tga_load_from_memory(), if options is a null pointer, the
+/// default options are used.
+///
+/// \param data_out Returns the image pixels data.
+/// \param info_out Returns the information of the image. Uses
+///                 tga_free_image() to release both of them.
+/// \param buffer The TGA format data to be decoded.
+/// \param size The byte size of the buffer.
+/// \param options The options for loading the image.
+/// \return The result of loading the image.
+///
+enum tga_error tga_load_from_memory_with_options(
+    uint8_t **data_out, tga_info **info_out, const void *buffer, size_t size,
+    const struct tga_load_options *options);
+
+///
+/// \brief Loads an image from TGA format file into a caller-provided buffer.
+///
+/// Same function as tga_load_with_options(), except that the image data is
+/// decoded directly into the destination instead of a new buffer. The pixels
+/// of the destination outside the image are not touched. Uses tga_probe() to
+/// get the pixel format and the size of the image in advance.
+///
+/// \param destination The buffer to decode the image into.
+/// \param info_out Returns the information of the image, can be a null
+///                 pointer if not needed. Uses tga_free_info() to release.
+/// \param file_name The TGA format file name to be loaded.
+/// \param options The options for loading the image, null means the default
+///                options.
+/// \return The result of loading the image, TGA_ERROR_INVALID_IMAGE_DIMENSIONS
+///         if the image does not fit in the destination. The content of the
+///         destination is undefined if loading failed.
+///
+enum tga_error tga_load_into(const struct tga_destination *destination,
+                             tga_info **info_out, const char *file_name,
+                             const struct tga_load_options *options);
+
+///
+/// \brief Loads an image from TGA format data in memory into a
+///        caller-provided buffer.
+///
+/// Same function as tga_load_into().
+///
+/// \param destination The buffer to decode the image into.
+/// \param info_out Returns the information of the image, can be a null
+///                 pointer if not needed. Uses tga_free_info() to release.
+/// \param buffer The TGA format data to be decoded.
+/// \param size The byte size of the buffer.
+/// \param options The options for loading the image, null means the default
+///                options.
+/// \return The result of loading the image.
+///
+enum tga_error tga_load_from_memory_into(
+    const struct tga_destination *destination, tga_info **info_out,
+    const void *buffer, size_t size, const struct tga_load_options *options);
+
+///
+/// \brief Loads a rectangular region of an image from TGA format file.
+///
+/// Same function as tga_load_with_options(), except that only the pixels
+/// inside the region are decoded, and the loaded image has the size of the
+/// region. The region is in the coordinates of the loaded image, whose origin
+/// is in the upper left corner whatever the order of the pixels in the file.
+/// The scanlines before the region are skipped, seeking over them in
+/// uncompressed files and walking the packet headers in RLE files, and the
+/// file is not read after the last scanline of the region.
+///
+/// \param data_out Returns the pixels data of the region.
+/// \param info_out Returns the information of the region. Uses
+///                 tga_free_image() to release both of them.
+/// \param file_name The TGA format file name to be loaded.
+/// \param x The left column of the region.
+/// \param y The top row of the region.
+/// \param width The width of the region.
+/// \param height The height of the region.
+/// \param options The options for loading the image, null means the default
+///                options. The region is always decoded on the calling thread.
+/// \return The result of loading the region,
+///         TGA_ERROR_INVALID_IMAGE_DIMENSIONS if the region is empty or not
+///         inside the image.
+///
+enum tga_error tga_load_region(uint8_t **data_out, tga_info **info_out,
+                               const char *file_name, int x, int y, int width,
+                               int height,
+                               const struct tga_load_options *options);
+
+///
+/// \brief Loads a rectangular region of an image from TGA format data in
+///        memory.
+///
+/// Same function as tga_load_region().
+///
+/// \param data_out Returns the pixels data of the region.
+/// \param info_out Returns the information of the region. Uses
+///                 tga_free_image() to release both of them.
+/// \param buffer The TGA format data to be decoded.
+/// \param size The byte size of the buffer.
+/// \param x The left column of the region.
+/// \param y The top row of the region.
+/// \param width The width of the region.
+/// \param height The height of the region.
+/// \param options The options for loading the image, null means the default
+///                options.
+/// \return The result of loading the region.
+///
+enum tga_error tga_load_region_from_memory(
+    uint8_t **data_out, tga_info **info_out, const void *buffer, size_t size,
+    int x, int y, int width, int height,
+    const struct tga_load_options *options);
+
+///
+/// \brief A level of the mip chain loaded by tga_load_mip_chain().
+///
+struct tga_mip_level {
+    ///
+    /// \brief The pixels data of the level, released with info by
+    /// tga_free_image().
+    ///
+    uint8_t *data;
+    ///
+    /// \brief The information of the level, the width and height are those of
+    /// the level. Uses tga_free_image() with data to release.
+    ///
+    tga_info *info;
+};
+
+///
+/// \brief Loads an image from TGA format file as a mip chain.
+///
+/// The first level is the loaded image, reduced if the scale_denominator of
+/// the options is set. Each next level is half the size of the previous one,
+/// rounded up, down to 1x1 or until max_level_count levels. Each pixel is the
+/// average of 2x2 pixels of the previous level. All levels are built in a
+/// single pass over the scanlines of the file. The TGA_PIXEL_INDEX8 format
+/// cannot be reduced.
+///
+/// \param levels Returns the levels, must have room for max_level_count
+///               levels. Uses tga_free_image() to release each level.
+/// \param max_level_count The maximum number of levels,
+///                        TGA_MAX_MIP_LEVEL_COUNT is enough for any image.
+/// \param level_count_out Returns the number of levels.
+/// \param file_name The TGA format file name to be loaded.
+/// \param options The options for loading the image, null means the default
+///                options.
+/// \return The result of loading the image. No level is returned if loading
+///         failed.
+///
+enum tga_error tga_load_mip_chain(struct tga_mip_level *levels,
+                                  int max_level_count, int *level_count_out,
+                                  const char *file_name,
+                                  const struct tga_load_options *options);
+
+///
+/// \brief Loads an image from TGA format data in memory as a mip chain.
+///
+/// Same function as tga_load_mip_chain().
+///
+/// \param levels Returns the levels, must have room for max_level_count
+///               levels. Uses tga_free_image() to release each level.
+/// \param max_level_count The maximum number of levels.
+/// \param level_count_out Returns the number of levels.
+/// \param buffer The TGA format data to be decoded.
+/// \param size The byte size of the buffer.
+/// \param options The options for loading the image, null means the default
+///                options.
+/// \return The result of loading the image.
+///
+enum tga_error tga_load_mip_chain_from_memory(
+    struct tga_mip_level *levels, int max_level_count, int *level_count_out,
+    const void *buffer, size_t size, const struct tga_load_options *options);
+
+///
+/// \brief Reads the header of a TGA format file without loading the image.
+///
+/// Only the header and the image ID field at the beginning of the file are
+/// read. The header is checked in the same way as tga_load() does, so a file
+/// that passes the probe can be loaded unless its image data is broken.
+///
+/// \param header_out Returns the header fields.
+/// \param file_name The TGA format file name to be probed.
+/// \return The result of reading the header.
+///
+enum tga_error tga_probe(struct tga_header_info *header_out,
+                         const char *file_name);
+
+///
+/// \brief Reads the header of TGA format data in memory without decoding the
+///        image.
+///
+/// Same function as tga_probe().
+///
+/// \param header_out Returns the header fields.
+/// \param buffer The TGA format data, only the beginning of the data needs to
+///               be in the buffer.
+/// \param size The byte size of the buffer.
+/// \return The result of reading the header.
+///
+enum tga_error tga_probe_memory(struct tga_header_info *header_out,
+                                const void *buffer, size_t size);
+
+///
+/// \brief Loads a batch of images.
+///
+/// The items are distributed to the threads dynamically: each thread takes the
+/// next item as soon as it finishes the previous one, so both the file reading
+/// and the decoding of different items overlap. The results are returned in
+/// the data, info and error_code fields of each item, the images that were
+/// loaded successfully must be released even if other items failed.
+/// ```
+/// struct tga_batch_options options = {0};
+/// options.thread_count = 8;
+/// tga_load_batch(items, item_count, &options);
+/// for (int i = 0; i < item_count; i++) {
+///     if (items[i].error_code == TGA_NO_ERROR) {
+///         // Uses items[i].data and items[i].info.
+///         tga_free_image(items[i].data, items[i].info);
+///     }
+/// }
+/// ```
+///
+/// \param items The images to be loaded.
+/// \param item_count The number of items.
+/// \param options The options for loading the batch, null means the default
+///                options.
+/// \return TGA_NO_ERROR if all images are loaded, otherwise the error of the
+///         first failed item.
+///
+enum tga_error tga_load_batch(struct tga_batch_item *items, int item_count,
+                              const struct tga_batch_options *options);
+
+///
+/// \brief Creates a loader to load images asynchronously.
+///
+/// The loads submitted to the loader are queued and executed by its threads,
+/// so the caller can keep working while the files are read and decoded. If
+/// the threads are not available, each load is executed when submitted.
+/// ```
+/// tga_loader *loader;
+/// if (tga_loader_create(&loader, 4) == TGA_NO_ERROR) {
+///     tga_load_request *request;
+///     tga_loader_submit(loader, &request, file_name, NULL);
+///     // Does other work, tga_load_poll() checks whether the load is done.
+///     if (tga_load_wait(request, &data, &info) == TGA_NO_ERROR) {
+///         // Uses the image, then releases data and info.
+///     }
+///     tga_loader_destroy(loader);
+/// }
+/// ```
+///
+/// \param loader_out Returns the loader. Uses tga_loader_destroy() to release.
+/// \param thread_count The number of threads of the loader.
+/// \return The result of creating the loader.
+///
+enum tga_error tga_loader_create(tga_loader **loader_out, int thread_count);
+
+///
+/// \brief Submits a TGA format file to be loaded by the loader.
+///
+/// \param loader The loader.
+/// \param request_out Returns the submitted load. Uses tga_load_wait() to get
+///                    the result and release it.
+/// \param file_name The TGA format file name to be loaded, is copied by the
+///                  function.
+/// \param options The options for loading the image, is copied by the
+///                function. Null means the default options.
+/// \return The result of submitting the load, not the result of loading.
+///
+enum tga_error tga_loader_submit(tga_loader *loader,
+                                 tga_load_request **request_out,
+                                 const char *file_name,
+                                 const struct tga_load_options *options);
+
+///
+/// \brief Submits TGA format data in memory to be decoded by the loader.
+///
+/// Same function as tga_loader_submit(), the buffer must be kept alive until
+/// tga_load_wait() returns.
+///
+/// \param loader The loader.
+/// \param request_out Returns the submitted load. Uses tga_load_wait() to get
+///                    the result and release it.
+/// \param buffer The TGA format data to be decoded.
+/// \param size The byte size of the buffer.
+/// \param options The options for loading the image, is copied by the
+///                function. Null means the default options.
+/// \return The result of submitting the load, not the result of loading.
+///
+enum tga_error tga_loader_submit_memory(tga_loader *loader,
+                                        tga_load_request **request_out,
+                                        const void *buffer, size_t size,
+                                        const struct tga_load_options *options);
+
+///
+/// \brief Checks whether a submitted load is done, without blocking.
+///
+/// \return Non-zero if the load is done, then tga_load_wait() returns
+///         immediately.
+///
+int tga_load_poll(tga_load_request *request);
+
+///
+/// \brief Waits for a submitted load to finish and releases the request.
+///
+/// \param request The submitted load, it cannot be used after the call.
+/// \param data_out Returns the image pixels data.
+/// \param info_out Returns the information of the image. Uses
+///                 tga_free_image() to release both of them.
+/// \return The result of loading the image.
+///
+enum tga_error tga_load_wait(tga_load_request *request, uint8_t **data_out,
+                             tga_info **info_out);
+
+///
+/// \brief Stops the threads of the loader and releases it.
+///
+/// All requests submitted to the loader must have been waited for by
+/// tga_load_wait() before calling this function.
+///
+/// \param loader The loader to be released.
+///
+void tga_loader_destroy(tga_loader *loader);
+
+///
+/// \brief Creates an arena, a block of memory that the images are allocated
+///        from by bumping an offset.
+///
+/// All images and temporary buffers allocated from the arena are released at
+/// once by tga_arena_reset(), there is no need to release them one by one. The
+/// arena can be shared by multiple threads.
+/// ```
+/// tga_arena *arena;
+/// tga_arena_create(&arena, 64 * 1024 * 1024);
+/// struct tga_allocator allocator;
+/// tga_arena_get_allocator(arena, &allocator);
+/// struct tga_load_options options = {0};
+/// options.allocator = &allocator;
+/// // Loads images with the options...
+/// tga_arena_reset(arena);
+/// tga_arena_destroy(arena);
+/// ```
+///
+/// \param arena_out Returns the arena. Uses tga_arena_destroy() to release.
+/// \param capacity The byte size of the memory block.
+/// \return The result of creating the arena.
+///
+enum tga_error tga_arena_create(tga_arena **arena_out, size_t capacity);
+
+///
+/// \brief Gets the allocator which allocates memory from the arena.
+///
+/// \param arena The arena.
+/// \param allocator_out Returns the allocator, it is valid until the arena is
+///                      destroyed.
+///
+void tga_arena_get_allocator(tga_arena *arena,
+                             struct tga_allocator *allocator_out);
+
+///
+/// \brief Gets the number of bytes allocated from the arena, including the
+///        alignment padding.
+///
+size_t tga_arena_get_used_size(tga_arena *arena);
+
+///
+/// \brief Releases all memory allocated from the arena.
+///
+/// The images allocated from the arena cannot be used after the call.
+///
+void tga_arena_reset(tga_arena *arena);
+
+///
+/// \brief Releases the arena and its memory block.
+///
+void tga_arena_destroy(tga_arena *arena);
+
+///
+/// \brief Opens a TGA format file to read the image scanline by scanline.
+///
+/// Only the information of the image is loaded when opening, the image data is
+/// decoded by tga_read_scanlines() into buffers provided by the caller. So the
+/// memory usage does not depend on the image size.
+/// ```
+/// tga_reader *reader;
+/// if (tga_reader_open(&reader, file_name, NULL) == TGA_NO_ERROR) {
+///     const tga_info *info = tga_reader_get_info(reader);
+///     uint8_t *row = malloc(tga_get_image_width(info) *
+///                           tga_get_bytes_per_pixel(info));
+///     while (tga_reader_get_remaining_rows(reader) > 0) {
+///         if (tga_read_scanlines(reader, row, 1) != TGA_NO_ERROR) {
+///             break;
+///         }
+///         // Use the scanline...
+///     }
+///     free(row);
+///     tga_reader_close(reader);
+/// }
+/// ```
+///
+/// \param reader_out Returns the reader. Uses tga_reader_close() to release.
+/// \param file_name The TGA format file name to be read.
+/// \param options The options for loading the image, can be a null pointer.
+/// \return The result of opening the file.
+///
+enum tga_error tga_reader_open(tga_reader **reader_out, const char *file_name,
+                               const struct tga_load_options *options);
+
+///
+/// \brief Opens TGA format data in memory to read the image scanline by
+///        scanline.
+///
+/// Same function as tga_reader_open(). The buffer is not copied, it must stay
+/// valid until tga_reader_close() is called.
+///
+/// \param reader_out Returns the reader. Uses tga_reader_close() to release.
+/// \param buffer The TGA format data to be read.
+/// \param size The byte size of the buffer.
+/// \param options The options for loading the image, can be a null pointer.
+/// \return The result of opening the data.
+///
+enum tga_error tga_reader_open_memory(tga_reader **reader_out,
+                                      const void *buffer, size_t size,
+                                      const struct tga_load_options *options);
+
+///
+/// \brief Gets the information of the image being read.
+///
+/// \param reader The reader of the image.
+/// \return The tga_info structure of the image, valid until tga_reader_close()
+///         is called. Do not release it with tga_free_info().
+///
+const tga_info *tga_reader_get_info(const tga_reader *reader);
+
+///
+/// \brief Checks the order in which the file stores the scanlines.
+///
+/// The scanlines are read in the order of the file. Use this function to find
+/// out the row of each scanline.
+///
+/// \param reader The reader of the image.
+/// \return Non-zero if the scanlines are stored from bottom to top, that is,
+///         the first scanline read is the bottom row of the image. 0 if they
+///         are stored from top to bottom.
+///
+int tga_reader_is_bottom_up(const tga_reader *reader);
+
+///
+/// \brief Gets the number of scanlines that have not been read.
+///
+/// \param reader The reader of the image.
+/// \return The number of remaining scanlines.
+///
+int tga_reader_get_remaining_rows(const tga_reader *reader);
+
+///
+/// \brief Reads the next scanlines of the image.
+///
+/// The scanlines are stored one after another in data, in the order of the
+/// file. The pixels of each scanline are always stored from left to right.
+///
+/// \param reader The reader of the image.
+/// \param data The buffer to store the scanlines, its size must be at least
+///             count * width * bytes per pixel.
+/// \param count The number of scanlines to read. If it is greater than the
+///              number of remaining scanlines, the function reads nothing and
+///              returns TGA_ERROR_NO_DATA.
+/// \return The result of reading the scanlines.
+///
+enum tga_error tga_read_scanlines(tga_reader *reader, uint8_t *data,
+                                  int count);
+
+///
+/// \brief Closes the reader.
+///
+/// If the reader is a null pointer, the function does nothing.
+///
+/// \param reader The reader to be closed.
+///
+void tga_reader_close(tga_reader *reader);
+
+///
+/// \brief Maps a TGA format file into memory for reading.
 ///
-/// The pixel data are all in little-endian. E.g. a TGA_PIXEL_ARGB32 format
-/// image, a single pixel is stored in the memory in the order of
-/// BBBBBBBB GGGGGGGG RRRRRRRR AAAAAAAA.
+/// For uncompressed true-color and grayscale images whose pixels are stored
+/// from left to right, the pixel data is not copied, the returned pointer
+/// points directly into the mapped file. Otherwise (RLE, color mapped or right
+/// to left images, or the platform does not support memory mapping), the image
+/// is decoded as tga_load() does.
 ///
-enum tga_pixel_format {
-    ///
-    /// \brief Single channel format represents grayscale, 8-bit integer.
-    ///
-    TGA_PIXEL_BW8,
-    ///
-    /// \brief Single channel format represents grayscale, 16-bit integer.
-    ///
-    TGA_PIXEL_BW16,
-    ///
-    /// \brief A 16-bit pixel format.
-    /// The topmost bit is assumed to an attribute bit, usually ignored.
-    /// Because of little-endian, this format pixel is stored in the memory in
-    /// the order of GGGBBBBB ARRRRRGG.
-    ///
-    TGA_PIXEL_RGB555,
-    ///
-    /// \brief RGB color format, 8-bit per channel.
-    ///
-    TGA_PIXEL_RGB24,
-    ///
-    /// \brief RGB color with alpha format, 8-bit per channel.
-    ///
-    TGA_PIXEL_ARGB32
-};
+/// The rows are not necessarily stored in order from top to bottom. Row y
+/// (counting from the top) starts at `data + y * stride`, the stride is
+/// negative when the file stores the rows from bottom to top.
+/// ```
+/// tga_mapped_image *image;
+/// if (tga_map(&image, file_name) == TGA_NO_ERROR) {
+///     const uint8_t *data = tga_mapped_get_data(image);
+///     int stride = tga_mapped_get_stride(image);
+///     const tga_info *info = tga_mapped_get_info(image);
+///     for (int y = 0; y < tga_get_image_height(info); y++) {
+///         const uint8_t *row = data + y * stride;
+///         // Use the pixels of the row...
+///     }
+///     tga_unmap(image);
+/// }
+/// ```
+///
+/// \param image_out Returns the mapped image. Uses tga_unmap() to release.
+/// \param file_name The TGA format file name to be mapped.
+/// \return The result of mapping the image.
+///
+enum tga_error tga_map(tga_mapped_image **image_out, const char *file_name);
 
 ///
-/// \brief Error code list.
+/// \brief Gets the pixel data of a mapped image.
 ///
-enum tga_error {
-    TGA_NO_ERROR = 0,
-    TGA_ERROR_OUT_OF_MEMORY,
-    TGA_ERROR_FILE_CANNOT_READ,
-    TGA_ERROR_FILE_CANNOT_WRITE,
-    TGA_ERROR_NO_DATA,
-    TGA_ERROR_UNSUPPORTED_COLOR_MAP_TYPE,
-    TGA_ERROR_UNSUPPORTED_IMAGE_TYPE,
-    TGA_ERROR_UNSUPPORTED_PIXEL_FORMAT,
-    TGA_ERROR_INVALID_IMAGE_DIMENSIONS,
-    TGA_ERROR_COLOR_MAP_INDEX_FAILED
-};
+/// \param image The image mapped by tga_map().
+/// \return Pointer to the first pixel of the top row. The data is read-only and
+///         valid until tga_unmap() is called.
+///
+const uint8_t *tga_mapped_get_data(const tga_mapped_image *image);
 
 ///
-/// \brief Structure for saving image information.
+/// \brief Gets the byte distance from one row of a mapped image to the row
+///        below it.
 ///
-typedef struct tga_info tga_info;
+/// \param image The image mapped by tga_map().
+/// \return The row stride, negative if the rows are stored from bottom to top.
+///
+int tga_mapped_get_stride(const tga_mapped_image *image);
 
 ///
-/// \brief Creates a empty image.
+/// \brief Gets the information of a mapped image.
 ///
-/// The coordinates of the image start from the upper left corner. Image pixel
-/// data is stored in a 1-dimensional array in a row major order.
-/// ```
-/// enum tga_error error_code;
-/// uint8_t *image_data;
-/// tga_info *image_info;
-/// error_code = tga_create(&image_data, &image_info, 128, 128,
-///                         TGA_PIXEL_RGB24);
-/// if (error_code == TGA_NO_ERROR) {
-///     // Use the created image...
-/// }
-/// ```
+/// \param image The image mapped by tga_map().
+/// \return The tga_info structure of the image, valid until tga_unmap() is
+///         called. Do not release it with tga_free_info().
 ///
-/// \param data_out Returns the image pixels data, all pixel values are set
-///                 to 0x0. Uses tga_free_data() to release.
-/// \param info_out Returns the information of the image. Uses tga_free_info()
-///                 to release.
-/// \param width The width of the image, the value cannot be less than 1 or
-///              greater than TGA_MAX_IMAGE_DIMENSISNS.
-/// \param height The height of the image. the value cannot be less than 1 or
-///               greater than TGA_MAX_IMAGE_DIMENSISNS.
-/// \param format Image pixel format.
-/// \return The result of the creation.
+const tga_info *tga_mapped_get_info(const tga_mapped_image *image);
+
 ///
-enum tga_error tga_create(uint8_t **data_out, tga_info **info_out, int width,
-                          int height, enum tga_pixel_format format);
+/// \brief Checks whether the pixel data of a mapped image points directly into
+///        the file mapping.
+///
+/// \param image The image mapped by tga_map().
+/// \return Non-zero if the pixel data was not copied, 0 if the image has been
+///         decoded.
+///
+int tga_mapped_is_zero_copy(const tga_mapped_image *image);
 
 ///
-/// \brief Loads image data and information from TGA format file.
+/// \brief Releases a mapped image.
 ///
-/// The coordinates of the image start from the upper left corner. Image pixel
-/// data is stored in a 1-dimensional array in a row major order.
-/// ```
-/// enum tga_error error_code;
-/// uint8_t *image_data;
-/// tga_info *image_info;
-/// error_code = tga_load(&image_data, &image_info, file_name);
-/// if (error_code == TGA_NO_ERROR) {
-///     // Use the loaded image...
-/// }
-/// ```
+/// If the image is a null pointer, the function does nothing.
 ///
-/// \param data_out Returns the image pixels data. Uses tga_free_data() to
-///                 release.
-/// \param info_out Returns the information of the image. Uses tga_free_info()
-///                 to release.
-/// \param file_name The TGA format file name to be loaded.
-/// \return The result of loading the image.
+/// \param image The image to be released.
 ///
-enum tga_error tga_load(uint8_t **data_out, tga_info **info_out,
-                        const char *file_name);
+void tga_unmap(tga_mapped_image *image);
 
 ///
 /// \brief Saves a image data as a TGA format file.
@@ -165,7 +1176,8 @@ enum tga_error tga_save(const uint8_t *data, int width, int height,
 ///
 /// \brief Saves a image data as a TGA format file.
 ///
-/// Is the simplified parameter form of the tga_save() function.
+/// Is the simplified parameter form of the tga_save() function. A
+/// TGA_PIXEL_INDEX8 format image is saved together with its color map.
 ///
 /// Note that if a file with the same name already exists, the save will fail.
 /// If data or info is a null pointer, the function does nothing.
@@ -178,6 +1190,105 @@ enum tga_error tga_save(const uint8_t *data, int width, int height,
 enum tga_error tga_save_from_info(const uint8_t *data, const tga_info *info,
                                   const char *file_name);
 
+///
+/// \brief Saves a image data as a TGA format file with the specified options.
+///
+/// Same function as tga_save_from_info(), if options is a null pointer, the
+/// default options are used.
+///
+/// With the TGA_SAVE_RLE flag, the image data is compressed with run-length
+/// encoding. The packets never cross scanlines, as required by the TGA 2.0
+/// specification.
+///
+/// \param data The data of the image.
+/// \param info The tga_info structure of the image.
+/// \param file_name The name of the image file to be created.
+/// \param options The options for saving the image.
+/// \return The result of saving the image.
+///
+enum tga_error tga_save_with_options(const uint8_t *data, const tga_info *info,
+                                     const char *file_name,
+                                     const struct tga_save_options *options);
+
+///
+/// \brief Creates a TGA format file to write the image scanline by scanline.
+///
+/// The header is written when opening, the image data is then written by
+/// tga_write_scanlines() from the top row to the bottom row. So the whole image
+/// does not need to be in memory.
+/// ```
+/// tga_writer *writer;
+/// error_code = tga_writer_open(&writer, width, height, TGA_PIXEL_RGB24,
+///                              file_name, NULL);
+/// if (error_code == TGA_NO_ERROR) {
+///     for (int y = 0; y < height; y += band_height) {
+///         // Render a band of the image...
+///         tga_write_scanlines(writer, band_data, band_height);
+///     }
+///     error_code = tga_writer_close(writer);
+/// }
+/// ```
+///
+/// Note that if a file with the same name already exists, the opening will
+/// fail.
+///
+/// \param writer_out Returns the writer. Uses tga_writer_close() to release.
+/// \param width The width of the image, the value cannot be less than 1 or
+///              greater than TGA_MAX_IMAGE_DIMENSISNS.
+/// \param height The height of the image. the value cannot be less than 1 or
+///               greater than TGA_MAX_IMAGE_DIMENSISNS.
+/// \param format Image pixel format.
+/// \param file_name The name of the image file to be created.
+/// \param options The options for saving the image, can be a null pointer.
+/// \return The result of creating the file.
+///
+enum tga_error tga_writer_open(tga_writer **writer_out, int width, int height,
+                               enum tga_pixel_format format,
+                               const char *file_name,
+                               const struct tga_save_options *options);
+
+///
+/// \brief Creates a TGA format file to write the image scanline by scanline.
+///
+/// Is the simplified parameter form of the tga_writer_open() function. A
+/// TGA_PIXEL_INDEX8 format image is saved together with its color map.
+///
+/// \param writer_out Returns the writer. Uses tga_writer_close() to release.
+/// \param info The tga_info structure of the image.
+/// \param file_name The name of the image file to be created.
+/// \param options The options for saving the image, can be a null pointer.
+/// \return The result of creating the file.
+///
+enum tga_error tga_writer_open_from_info(
+    tga_writer **writer_out, const tga_info *info, const char *file_name,
+    const struct tga_save_options *options);
+
+///
+/// \brief Writes the next scanlines of the image.
+///
+/// \param writer The writer of the image.
+/// \param data The scanlines stored one after another from top to bottom.
+/// \param count The number of scanlines to write. If it is greater than the
+///              number of scanlines not written yet, the function writes
+///              nothing and returns TGA_ERROR_NO_DATA.
+/// \return The result of writing the scanlines.
+///
+enum tga_error tga_write_scanlines(tga_writer *writer, const uint8_t *data,
+                                   int count);
+
+///
+/// \brief Finishes writing the file and releases the writer.
+///
+/// If not all scanlines of the image have been written, or an error occurred
+/// while writing, the file is removed. If the writer is a null pointer, the
+/// function does nothing.
+///
+/// \param writer The writer to be closed.
+/// \return The result of writing the file, TGA_ERROR_NO_DATA if the image is
+///         incomplete.
+///
+enum tga_error tga_writer_close(tga_writer *writer);
+
 ///
 /// \brief Gets the image width.
 ///
@@ -211,6 +1322,45 @@ enum tga_pixel_format tga_get_pixel_format(const tga_info *info);
 ///
 uint8_t tga_get_bytes_per_pixel(const tga_info *info);
 
+///
+/// \brief Gets the color map of a TGA_PIXEL_INDEX8 format image.
+///
+/// The entries are stored one after another in the pixel format determined by
+/// the entry size: TGA_PIXEL_RGB555 for 2 bytes, TGA_PIXEL_RGB24 for 3 bytes
+/// and TGA_PIXEL_ARGB32 for 4 bytes. A pixel with index value i uses the entry
+/// i - tga_get_color_map_first_index(). The indices are not checked when
+/// loading, an index may be outside the color map.
+///
+/// \param info The tga_info structure of the image.
+/// \return The color map entries, or a null pointer if the image has no color
+///         map. The color map is released together with the info structure.
+///
+const uint8_t *tga_get_color_map(const tga_info *info);
+
+///
+/// \brief Gets the index value of the first color map entry.
+///
+/// \param info The tga_info structure of the image.
+/// \return The index value of the first entry, 0 if there is no color map.
+///
+int tga_get_color_map_first_index(const tga_info *info);
+
+///
+/// \brief Gets the number of color map entries.
+///
+/// \param info The tga_info structure of the image.
+/// \return The number of entries, 0 if there is no color map.
+///
+int tga_get_color_map_length(const tga_info *info);
+
+///
+/// \brief Gets the byte size of a color map entry.
+///
+/// \param info The tga_info structure of the image.
+/// \return The byte size of an entry, 0 if there is no color map.
+///
+uint8_t tga_get_color_map_entry_size(const tga_info *info);
+
 ///
 /// \brief Returns the pointer to the pixel at coordinates (x,y) in the data for
 ///        reading or writing.
@@ -231,6 +1381,102 @@ uint8_t tga_get_bytes_per_pixel(const tga_info *info);
 ///
 uint8_t *tga_get_pixel(uint8_t *data, const tga_info *info, int x, int y);
 
+///
+/// \brief Returns the pointer to the pixel at coordinates (x,y) in image data
+///        whose rows are stride bytes apart.
+///
+/// Same function as tga_get_pixel(), for images that are not tightly packed,
+/// e.g. loaded by tga_load_into().
+///
+/// \param data The data pointer of the upper left pixel of the image.
+/// \param stride Byte distance from one row of the image to the next.
+/// \param info The tga_info structure of the image.
+/// \param x The x coordinate of the pixel.
+/// \param y The y coordinate of the pixel
+/// \return Pointer to the lowest byte of the pixel.
+///
+uint8_t *tga_get_pixel_with_stride(uint8_t *data, size_t stride,
+                                   const tga_info *info, int x, int y);
+
+///
+/// \brief A lightweight view of the pixel data of an image.
+///
+/// The view caches everything needed to address a pixel, so that the inline
+/// accessors tga_view_get_row() and tga_get_pixel_unchecked() can be used in
+/// inner loops instead of tga_get_pixel(). The view does not own the data, it
+/// is valid as long as the data is.
+///
+struct tga_image_view {
+    ///
+    /// \brief Pointer to the upper left pixel of the image.
+    ///
+    uint8_t *data;
+    ///
+    /// \brief Byte distance from one row of the image to the next.
+    ///
+    size_t stride;
+    ///
+    /// \brief The byte size of a pixel.
+    ///
+    int bytes_per_pixel;
+    ///
+    /// \brief The image width in pixels.
+    ///
+    int width;
+    ///
+    /// \brief The image height in pixels.
+    ///
+    int height;
+    ///
+    /// \brief The pixel format of the image.
+    ///
+    enum tga_pixel_format pixel_format;
+};
+
+///
+/// \brief Fills a view of image data whose rows are tightly packed, e.g.
+///        created by tga_create() or loaded by tga_load().
+///
+/// \param view The view to fill.
+/// \param data The data pointer of the image.
+/// \param info The tga_info structure of the image.
+///
+void tga_get_image_view(struct tga_image_view *view, uint8_t *data,
+                        const tga_info *info);
+
+///
+/// \brief Fills a view of image data whose rows are stride bytes apart, e.g.
+///        loaded by tga_load_into().
+///
+/// \param view The view to fill.
+/// \param data The data pointer of the upper left pixel of the image.
+/// \param stride Byte distance from one row of the image to the next.
+/// \param info The tga_info structure of the image.
+///
+void tga_get_image_view_with_stride(struct tga_image_view *view, uint8_t *data,
+                                    size_t stride, const tga_info *info);
+
+///
+/// \brief Returns the pointer to the first pixel of row y of the view.
+///
+/// The row is not checked, y must be in [0, view->height).
+///
+static inline uint8_t *tga_view_get_row(const struct tga_image_view *view,
+                                        int y) {
+    return view->data + view->stride * (size_t)y;
+}
+
+///
+/// \brief Returns the pointer to the pixel at coordinates (x,y) of the view.
+///
+/// Same function as tga_get_pixel(), but the coordinates are not clamped, they
+/// must be inside the image.
+///
+static inline uint8_t *tga_get_pixel_unchecked(
+    const struct tga_image_view *view, int x, int y) {
+    return tga_view_get_row(view, y) + (size_t)x * view->bytes_per_pixel;
+}
+
 ///
 /// \brief Releases the image data.
 ///
@@ -251,6 +1497,19 @@ void tga_free_data(void *data);
 ///
 void tga_free_info(tga_info *info);
 
+///
+/// \brief Releases the image data and the tga_info structure of an image.
+///
+/// The data is released by the allocator of the info, so this function must
+/// be used for the images created or loaded with an allocator. It also works
+/// for the other images.
+///
+/// \param data The data to be released.
+/// \param info The tga_info structure to be released. If it is a null pointer,
+///             the data is released by free().
+///
+void tga_free_image(uint8_t *data, tga_info *info);
+
 ///
 /// \brief Flips the image horizontally.
 ///
@@ -262,6 +1521,20 @@ void tga_free_info(tga_info *info);
 ///
 void tga_image_flip_h(uint8_t *data, const tga_info *info);
 
+///
+/// \brief Flips the image horizontally, the rows of the image are stride bytes
+///        apart.
+///
+/// Same function as tga_image_flip_h(), the bytes between the rows are not
+/// touched.
+///
+/// \param data The data pointer of the upper left pixel of the image.
+/// \param stride Byte distance from one row of the image to the next.
+/// \param info The structure which contains the image information.
+///
+void tga_image_flip_h_with_stride(uint8_t *data, size_t stride,
+                                  const tga_info *info);
+
 ///
 /// \brief Flip the image vertically.
 ///
@@ -273,6 +1546,121 @@ void tga_image_flip_h(uint8_t *data, const tga_info *info);
 ///
 void tga_image_flip_v(uint8_t *data, const tga_info *info);
 
+///
+/// \brief Flips the image vertically, the rows of the image are stride bytes
+///        apart.
+///
+/// Same function as tga_image_flip_v(), the bytes between the rows are not
+/// touched.
+///
+/// \param data The data pointer of the upper left pixel of the image.
+/// \param stride Byte distance from one row of the image to the next.
+/// \param info The structure which contains the image information.
+///
+void tga_image_flip_v_with_stride(uint8_t *data, size_t stride,
+                                  const tga_info *info);
+
+///
+/// \brief Converts the image to another pixel format.
+///
+/// Creates a new image with the same dimensions and the given pixel format.
+/// The conversions to grayscale use the BT.601 luma, the conversions to
+/// TGA_PIXEL_RGB555 drop the low bits of each channel and the alpha channel.
+/// A TGA_PIXEL_INDEX8 image is expanded through its color map, and
+/// TGA_PIXEL_INDEX8 is not a valid target format. The new image uses the
+/// allocator of the source image, and must be released by tga_free_image().
+///
+/// \param data_out Pointer to the pointer of the converted image data.
+/// \param info_out Pointer to the pointer of the converted image information.
+/// \param data The source image data.
+/// \param info The source image information.
+/// \param format The pixel format of the converted image.
+///
+/// \return TGA_NO_ERROR if the image was converted, otherwise returns the
+///         error code and both *data_out and *info_out are unchanged.
+///
+enum tga_error tga_convert(uint8_t **data_out, tga_info **info_out,
+                           const uint8_t *data, const tga_info *info,
+                           enum tga_pixel_format format);
+
+///
+/// \brief Rotates the image 90 degrees clockwise.
+///
+/// Creates a new image whose width is the height of the source image and
+/// whose height is its width. The pixels are copied in square tiles, so that
+/// the columns read from the source stay in the cache. The rows of the new
+/// image are split into bands that are copied by up to thread_count threads.
+/// The new image uses the allocator of the source image and has a copy of its
+/// color map, it must be released by tga_free_image().
+///
+/// \param data_out Pointer to the pointer of the rotated image data.
+/// \param info_out Pointer to the pointer of the rotated image information.
+/// \param data The source image data.
+/// \param info The source image information.
+/// \param thread_count Maximum number of threads used, 0 or 1 means the
+///                     calling thread only.
+///
+/// \return TGA_NO_ERROR if the image was rotated, otherwise returns the error
+///         code and both *data_out and *info_out are unchanged.
+///
+enum tga_error tga_image_rotate_90(uint8_t **data_out, tga_info **info_out,
+                                   const uint8_t *data, const tga_info *info,
+                                   int thread_count);
+
+///
+/// \brief Rotates the image 180 degrees.
+///
+/// Same function as tga_image_rotate_90(), the new image has the size of the
+/// source image.
+///
+enum tga_error tga_image_rotate_180(uint8_t **data_out, tga_info **info_out,
+                                    const uint8_t *data, const tga_info *info,
+                                    int thread_count);
+
+///
+/// \brief Rotates the image 270 degrees clockwise, that is 90 degrees
+///        counterclockwise.
+///
+/// Same function as tga_image_rotate_90().
+///
+enum tga_error tga_image_rotate_270(uint8_t **data_out, tga_info **info_out,
+                                    const uint8_t *data, const tga_info *info,
+                                    int thread_count);
+
+///
+/// \brief Transposes the image, the pixel (x, y) of the new image is the
+///        pixel (y, x) of the source image.
+///
+/// Same function as tga_image_rotate_90().
+///
+enum tga_error tga_image_transpose(uint8_t **data_out, tga_info **info_out,
+                                   const uint8_t *data, const tga_info *info,
+                                   int thread_count);
+
+///
+/// \brief Copies a rectangle of the image to a new image.
+///
+/// The new image uses the allocator of the source image and has a copy of its
+/// color map, it must be released by tga_free_image().
+///
+/// \param data_out Pointer to the pointer of the cropped image data.
+/// \param info_out Pointer to the pointer of the cropped image information.
+/// \param data The source image data.
+/// \param info The source image information.
+/// \param x The left column of the rectangle.
+/// \param y The top row of the rectangle.
+/// \param width The width of the rectangle.
+/// \param height The height of the rectangle.
+///
+/// \return TGA_NO_ERROR if the image was cropped,
+///         TGA_ERROR_INVALID_IMAGE_DIMENSIONS if the rectangle is empty or not
+///         inside the image. Both *data_out and *info_out are unchanged on
+///         error.
+///
+enum tga_error tga_image_crop(uint8_t **data_out, tga_info **info_out,
+                              const uint8_t *data, const tga_info *info, int x,
+                              int y, int width, int height);
+
 #ifdef __cplusplus
 }
 #endif  //__cplusplus
@@ -0,0 +1,607 @@
+// Copyright (c) 2021 Caden Ji
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Header-only C++17 interface of tgafunc. The images are owned by the move-only
+// tga::Image, and the pixels are accessed through views whose pixel format is a
+// template parameter, so the per-pixel code has no format switch.
+
+#ifndef TGAFUNC_HPP_
+#define TGAFUNC_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "tgafunc.h"
+
+namespace tga {
+
+///
+/// \brief The pixel formats, same values as enum tga_pixel_format.
+///
+enum class Format {
+    BW8 = TGA_PIXEL_BW8,
+    BW16 = TGA_PIXEL_BW16,
+    RGB555 = TGA_PIXEL_RGB555,
+    RGB24 = TGA_PIXEL_RGB24,
+    ARGB32 = TGA_PIXEL_ARGB32,
+    INDEX8 = TGA_PIXEL_INDEX8,
+    ABGR32 = TGA_PIXEL_ABGR32,
+    ARGB64 = TGA_PIXEL_ARGB64
+};
+
+// The pixel structures have the memory layout of the formats. The 16-bit
+// fields assume a little-endian host, like the pixel data of the library.
+
+///
+/// \brief A TGA_PIXEL_BW8 pixel.
+///
+struct Bw8 {
+    uint8_t value;
+};
+
+///
+/// \brief A TGA_PIXEL_BW16 pixel.
+///
+struct Bw16 {
+    uint16_t value;
+};
+
+///
+/// \brief A TGA_PIXEL_RGB555 pixel, the bits are ARRRRRGGGGGBBBBB.
+///
+struct Rgb555 {
+    uint16_t value;
+};
+
+///
+/// \brief A TGA_PIXEL_RGB24 pixel.
+///
+struct Rgb24 {
+    uint8_t b, g, r;
+};
+
+///
+/// \brief A TGA_PIXEL_ARGB32 pixel.
+///
+struct Argb32 {
+    uint8_t b, g, r, a;
+};
+
+///
+/// \brief A TGA_PIXEL_INDEX8 pixel.
+///
+struct Index8 {
+    uint8_t index;
+};
+
+///
+/// \brief A TGA_PIXEL_ABGR32 pixel.
+///
+struct Abgr32 {
+    uint8_t r, g, b, a;
+};
+
+///
+/// \brief A TGA_PIXEL_ARGB64 pixel.
+///
+struct Argb64 {
+    uint16_t b, g, r, a;
+};
+
+static_assert(sizeof(Rgb24) == 3 && sizeof(Argb64) == 8,
+              "The pixel structures must not be padded.");
+
+///
+/// \brief Maps a format to its pixel structure.
+///
+template <Format F>
+struct FormatTraits;
+
+template <>
+struct FormatTraits<Format::BW8> {
+    using Pixel = Bw8;
+};
+
+template <>
+struct FormatTraits<Format::BW16> {
+    using Pixel = Bw16;
+};
+
+template <>
+struct FormatTraits<Format::RGB555> {
+    using Pixel = Rgb555;
+};
+
+template <>
+struct FormatTraits<Format::RGB24> {
+    using Pixel = Rgb24;
+};
+
+template <>
+struct FormatTraits<Format::ARGB32> {
+    using Pixel = Argb32;
+};
+
+template <>
+struct FormatTraits<Format::INDEX8> {
+    using Pixel = Index8;
+};
+
+template <>
+struct FormatTraits<Format::ABGR32> {
+    using Pixel = Abgr32;
+};
+
+template <>
+struct FormatTraits<Format::ARGB64> {
+    using Pixel = Argb64;
+};
+
+template <Format F>
+using Pixel = typename FormatTraits<F>::Pixel;
+
+///
+/// \brief The byte size of a pixel of the format.
+///
+template <Format F>
+inline constexpr int kPixelSize = static_cast<int>(sizeof(Pixel<F>));
+
+///
+/// \brief A view of the pixels of an image, P is the pixel structure and is
+///        const for read-only views.
+///
+/// The view does not own the pixels and does not check the coordinates. The
+/// stride must be a multiple of the alignment of the pixel structure.
+///
+template <typename P>
+class View {
+   public:
+    using Byte =
+        std::conditional_t<std::is_const_v<P>, const uint8_t, uint8_t>;
+
+    View() = default;
+
+    View(Byte *data, size_t stride, int width, int height)
+        : data_(data), stride_(stride), width_(width), height_(height) {
+        assert(stride % alignof(P) == 0);
+    }
+
+    ///
+    /// \brief A mutable view converts to a read-only view.
+    ///
+    template <typename Q, typename = std::enable_if_t<
+                              std::is_same_v<P, const Q> &&
+                              !std::is_same_v<P, Q>>>
+    View(const View<Q> &other)
+        : View(other.bytes(), other.stride(), other.width(), other.height()) {}
+
+    ///
+    /// \brief Views the pixels of a tga_image_view, whose bytes_per_pixel must
+    ///        be the size of P.
+    ///
+    explicit View(const tga_image_view &view)
+        : View(view.data, view.stride, view.width, view.height) {
+        assert(view.bytes_per_pixel == static_cast<int>(sizeof(P)));
+    }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    size_t stride() const { return stride_; }
+    Byte *bytes() const { return data_; }
+
+    ///
+    /// \brief Returns the pixels of row y, from left to right.
+    ///
+    P *row(int y) const {
+        return reinterpret_cast<P *>(data_ + stride_ * static_cast<size_t>(y));
+    }
+
+    P &operator()(int x, int y) const { return row(y)[x]; }
+
+   private:
+    Byte *data_ = nullptr;
+    size_t stride_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+};
+
+template <Format F>
+using ImageView = View<Pixel<F>>;
+
+template <Format F>
+using ConstImageView = View<const Pixel<F>>;
+
+namespace detail {
+
+// The conversions go through ARGB32 and give the same results as the
+// conversions of the library, see pixels_to_argb32() in tgafunc.c.
+
+constexpr Argb32 to_argb32(Bw8 p) { return {p.value, p.value, p.value, 0xFF}; }
+
+constexpr Argb32 to_argb32(Bw16 p) {
+    uint8_t value = static_cast<uint8_t>(p.value >> 8);
+    return {value, value, value, 0xFF};
+}
+
+constexpr uint8_t expand_5_bits(unsigned value) {
+    return static_cast<uint8_t>(value << 3 | value >> 2);
+}
+
+constexpr Argb32 to_argb32(Rgb555 p) {
+    return {expand_5_bits(p.value & 0x1F), expand_5_bits((p.value >> 5) & 0x1F),
+            expand_5_bits((p.value >> 10) & 0x1F), 0xFF};
+}
+
+constexpr Argb32 to_argb32(Rgb24 p) { return {p.b, p.g, p.r, 0xFF}; }
+
+constexpr Argb32 to_argb32(Argb32 p) { return p; }
+
+constexpr Argb32 to_argb32(Abgr32 p) { return {p.b, p.g, p.r, p.a}; }
+
+constexpr uint8_t round_to_8_bits(uint16_t value) {
+    return static_cast<uint8_t>((value * 255u + 32767) / 65535);
+}
+
+constexpr Argb32 to_argb32(Argb64 p) {
+    return {round_to_8_bits(p.b), round_to_8_bits(p.g), round_to_8_bits(p.r),
+            round_to_8_bits(p.a)};
+}
+
+// The luma of BT.601 in 16-bit fixed point.
+constexpr uint8_t get_luma(Argb32 c) {
+    return static_cast<uint8_t>(
+        (c.r * 19595u + c.g * 38470u + c.b * 7471u + 32768) >> 16);
+}
+
+template <typename P>
+constexpr P from_argb32(Argb32 c);
+
+template <>
+constexpr Bw8 from_argb32<Bw8>(Argb32 c) {
+    return {get_luma(c)};
+}
+
+template <>
+constexpr Bw16 from_argb32<Bw16>(Argb32 c) {
+    return {static_cast<uint16_t>(get_luma(c) * 257)};
+}
+
+template <>
+constexpr Rgb555 from_argb32<Rgb555>(Argb32 c) {
+    return {static_cast<uint16_t>((c.r >> 3) << 10 | (c.g >> 3) << 5 |
+                                  c.b >> 3)};
+}
+
+template <>
+constexpr Rgb24 from_argb32<Rgb24>(Argb32 c) {
+    return {c.b, c.g, c.r};
+}
+
+template <>
+constexpr Argb32 from_argb32<Argb32>(Argb32 c) {
+    return c;
+}
+
+template <>
+constexpr Abgr32 from_argb32<Abgr32>(Argb32 c) {
+    return {c.r, c.g, c.b, c.a};
+}
+
+template <>
+constexpr Argb64 from_argb32<Argb64>(Argb32 c) {
+    return {static_cast<uint16_t>(c.b * 257), static_cast<uint16_t>(c.g * 257),
+            static_cast<uint16_t>(c.r * 257), static_cast<uint16_t>(c.a * 257)};
+}
+
+}  // namespace detail
+
+///
+/// \brief Converts a pixel to another format, INDEX8 is not supported.
+///
+template <typename To, typename From>
+constexpr To convert_pixel(const From &pixel) {
+    if constexpr (std::is_same_v<To, From>) {
+        return pixel;
+    } else {
+        return detail::from_argb32<To>(detail::to_argb32(pixel));
+    }
+}
+
+///
+/// \brief Flips the image horizontally.
+///
+template <typename P>
+void flip_h(View<P> view) {
+    static_assert(!std::is_const_v<P>, "The view must be mutable.");
+    for (int y = 0; y < view.height(); y++) {
+        P *row = view.row(y);
+        std::reverse(row, row + view.width());
+    }
+}
+
+///
+/// \brief Flips the image vertically.
+///
+template <typename P>
+void flip_v(View<P> view) {
+    static_assert(!std::is_const_v<P>, "The view must be mutable.");
+    for (int y = 0; y < view.height() / 2; y++) {
+        P *row = view.row(y);
+        std::swap_ranges(row, row + view.width(),
+                         view.row(view.height() - 1 - y));
+    }
+}
+
+///
+/// \brief Copies the pixels of src to dest, both views have the same size.
+///
+template <typename P, typename Q>
+void copy(View<P> dest, View<Q> src) {
+    static_assert(std::is_same_v<P, std::remove_const_t<Q>>,
+                  "The views must have the same pixel format.");
+    assert(dest.width() == src.width() && dest.height() == src.height());
+    for (int y = 0; y < dest.height(); y++) {
+        std::copy(src.row(y), src.row(y) + src.width(), dest.row(y));
+    }
+}
+
+///
+/// \brief Converts the pixels of src to the format of dest, both views have
+///        the same size. INDEX8 is not supported, use Image::convert().
+///
+template <typename P, typename Q>
+void convert(View<P> dest, View<Q> src) {
+    using From = std::remove_const_t<Q>;
+    static_assert(!std::is_const_v<P>, "The destination must be mutable.");
+    static_assert(!std::is_same_v<P, Index8> && !std::is_same_v<From, Index8>,
+                  "The indexed pixels need the color map.");
+    assert(dest.width() == src.width() && dest.height() == src.height());
+    for (int y = 0; y < dest.height(); y++) {
+        const From *src_row = src.row(y);
+        P *dest_row = dest.row(y);
+        for (int x = 0; x < dest.width(); x++) {
+            dest_row[x] = convert_pixel<P>(src_row[x]);
+        }
+    }
+}
+
+///
+/// \brief An image which owns its pixel data and tga_info structure.
+///
+/// The image can be moved but not copied, it is released by tga_free_image()
+/// when destroyed. The functions return the error code of the C functions,
+/// and leave the image unchanged on error.
+///
+class Image {
+   public:
+    Image() = default;
+
+    ///
+    /// \brief Takes the ownership of an image created by the C functions.
+    ///
+    Image(uint8_t *data, tga_info *info) : data_(data), info_(info) {}
+
+    Image(const Image &) = delete;
+    Image &operator=(const Image &) = delete;
+
+    Image(Image &&other) noexcept : data_(other.data_), info_(other.info_) {
+        other.data_ = nullptr;
+        other.info_ = nullptr;
+    }
+
+    Image &operator=(Image &&other) noexcept {
+        if (this != &other) {
+            reset();
+            std::swap(data_, other.data_);
+            std::swap(info_, other.info_);
+        }
+        return *this;
+    }
+
+    ~Image() { reset(); }
+
+    ///
+    /// \brief Creates a black image, see tga_create().
+    ///
+    tga_error create(int width, int height, Format format) {
+        uint8_t *data;
+        tga_info *info;
+        tga_error error_code = tga_create(
+            &data, &info, width, height,
+            static_cast<tga_pixel_format>(format));
+        return adopt(error_code, data, info);
+    }
+
+    ///
+    /// \brief Loads a TGA file, see tga_load_with_options().
+    ///
+    tga_error load(const char *file_name,
+                   const tga_load_options *options = nullptr) {
+        uint8_t *data;
+        tga_info *info;
+        tga_error error_code =
+            tga_load_with_options(&data, &info, file_name, options);
+        return adopt(error_code, data, info);
+    }
+
+    ///
+    /// \brief Loads a TGA image from memory, see
+    ///        tga_load_from_memory_with_options().
+    ///
+    tga_error load_from_memory(const void *buffer, size_t size,
+                               const tga_load_options *options = nullptr) {
+        uint8_t *data;
+        tga_info *info;
+        tga_error error_code = tga_load_from_memory_with_options(
+            &data, &info, buffer, size, options);
+        return adopt(error_code, data, info);
+    }
+
+    ///
+    /// \brief Saves the image as a TGA file, see tga_save_with_options().
+    ///
+    tga_error save(const char *file_name,
+                   const tga_save_options *options = nullptr) const {
+        return tga_save_with_options(data_, info_, file_name, options);
+    }
+
+    ///
+    /// \brief Converts the image to another format into out, see
+    ///        tga_convert().
+    ///
+    tga_error convert(Image &out, Format format) const {
+        uint8_t *data;
+        tga_info *info;
+        tga_error error_code = tga_convert(
+            &data, &info, data_, info_, static_cast<tga_pixel_format>(format));
+        return out.adopt(error_code, data, info);
+    }
+
+    ///
+    /// \brief Releases the image, then the image is empty.
+    ///
+    void reset() {
+        if (info_ != nullptr) {
+            tga_free_image(data_, info_);
+        }
+        data_ = nullptr;
+        info_ = nullptr;
+    }
+
+    ///
+    /// \brief Gives up the ownership, the pair must then be released by
+    ///        tga_free_image().
+    ///
+    void release(uint8_t **data_out, tga_info **info_out) {
+        *data_out = data_;
+        *info_out = info_;
+        data_ = nullptr;
+        info_ = nullptr;
+    }
+
+    bool empty() const { return info_ == nullptr; }
+    explicit operator bool() const { return !empty(); }
+
+    uint8_t *data() { return data_; }
+    const uint8_t *data() const { return data_; }
+    const tga_info *info() const { return info_; }
+
+    // The properties below read the info, the image must not be empty.
+
+    int width() const {
+        assert(!empty());
+        return tga_get_image_width(info_);
+    }
+
+    int height() const {
+        assert(!empty());
+        return tga_get_image_height(info_);
+    }
+
+    Format format() const {
+        assert(!empty());
+        return static_cast<Format>(tga_get_pixel_format(info_));
+    }
+
+    int bytes_per_pixel() const {
+        assert(!empty());
+        return tga_get_bytes_per_pixel(info_);
+    }
+
+    size_t stride() const {
+        return static_cast<size_t>(width()) * bytes_per_pixel();
+    }
+
+    ///
+    /// \brief Returns a view of the pixels, the image must not be empty and F
+    ///        must be its format.
+    ///
+    template <Format F>
+    ImageView<F> view() {
+        assert(format() == F);
+        return ImageView<F>(data_, stride(), width(), height());
+    }
+
+    template <Format F>
+    ConstImageView<F> view() const {
+        assert(format() == F);
+        return ConstImageView<F>(data_, stride(), width(), height());
+    }
+
+   private:
+    tga_error adopt(tga_error error_code, uint8_t *data, tga_info *info) {
+        if (error_code == TGA_NO_ERROR) {
+            reset();
+            data_ = data;
+            info_ = info;
+        }
+        return error_code;
+    }
+
+    uint8_t *data_ = nullptr;
+    tga_info *info_ = nullptr;
+};
+
+///
+/// \brief Calls f with the view of the image in its format, f is instantiated
+///        for each format. The image must not be empty.
+///
+/// This is the only format switch, the work done by f is specialized for the
+/// pixel structure.
+///
+template <typename Function>
+void visit(Image &image, Function &&f) {
+    switch (image.format()) {
+        case Format::BW8:
+            f(image.view<Format::BW8>());
+            break;
+        case Format::BW16:
+            f(image.view<Format::BW16>());
+            break;
+        case Format::RGB555:
+            f(image.view<Format::RGB555>());
+            break;
+        case Format::RGB24:
+            f(image.view<Format::RGB24>());
+            break;
+        case Format::ARGB32:
+            f(image.view<Format::ARGB32>());
+            break;
+        case Format::INDEX8:
+            f(image.view<Format::INDEX8>());
+            break;
+        case Format::ABGR32:
+            f(image.view<Format::ABGR32>());
+            break;
+        case Format::ARGB64:
+            f(image.view<Format::ARGB64>());
+            break;
+    }
+}
+
+}  // namespace tga
+
+#endif  // TGAFUNC_HPP_